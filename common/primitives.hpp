@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Primitive meshes generated at compile time, shared by hw1, hw2 and the game.
+//
+// The tables are constexpr std::arrays, so a program carries the finished
+// vertex data in its read-only data and does no work at startup. Meshes are
+// indexed and unit sized, with outward normals and counter-clockwise triangles
+// seen from outside. triangle_positions() and friends unroll the indices into
+// the flat per-vertex arrays glDrawArrays takes.
+namespace Primitives {
+
+namespace detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+// std::sin is not constexpr: a Taylor series after reducing x to [-pi, pi]
+constexpr double sin(double x) {
+    double turns = x / (2 * PI);
+    long whole = long(turns + (turns >= 0 ? 0.5 : -0.5));
+    x -= 2 * PI * whole;
+    double term = x;
+    double sum = x;
+    for (int i = 1; i < 16; ++i) {
+        term *= -x * x / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cos(double x) {
+    return sin(x + PI / 2);
+}
+
+// unrolls an indexed attribute of Components floats per vertex
+template <size_t Components, size_t N, size_t IndexCount>
+constexpr std::array<float, Components * IndexCount> unindex(const std::array<float, N>& attribute,
+    const std::array<uint16_t, IndexCount>& indices) {
+    std::array<float, Components * IndexCount> result{};
+    for (size_t i = 0; i < IndexCount; ++i) {
+        for (size_t c = 0; c < Components; ++c) {
+            result[Components * i + c] = attribute[Components * indices[i] + c];
+        }
+    }
+    return result;
+}
+
+}  // namespace detail
+
+
+template <size_t VertexCount, size_t IndexCount>
+struct IndexedMesh {
+    static_assert(VertexCount <= 65536, "indices are 16 bit");
+    static_assert(IndexCount % 3 == 0, "indices form triangles");
+
+    static constexpr size_t vertex_count = VertexCount;
+    static constexpr size_t index_count = IndexCount;
+
+    std::array<float, 3 * VertexCount> positions{};
+    std::array<float, 3 * VertexCount> normals{};
+    std::array<float, 2 * VertexCount> texcoords{};
+    std::array<uint16_t, IndexCount> indices{};
+
+    // xyz of each triangle corner, index_count vertices
+    constexpr std::array<float, 3 * IndexCount> triangle_positions() const {
+        return detail::unindex<3>(positions, indices);
+    }
+
+    constexpr std::array<float, 3 * IndexCount> triangle_normals() const {
+        return detail::unindex<3>(normals, indices);
+    }
+
+    constexpr std::array<float, 2 * IndexCount> triangle_texcoords() const {
+        return detail::unindex<2>(texcoords, indices);
+    }
+};
+
+
+// Spans [-1, 1] on every axis. Faces have their own corners for flat normals.
+constexpr IndexedMesh<24, 36> cube() {
+    // normal, then two edges with u x v = normal
+    constexpr float faces[6][3][3] = {
+        {{ 1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+        {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0,  1, 0}, {0, 0, 1}, {1, 0, 0}},
+        {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0,  1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}},
+    };
+    constexpr float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+
+    IndexedMesh<24, 36> mesh{};
+    for (size_t face = 0; face < 6; ++face) {
+        const auto& n = faces[face][0];
+        const auto& u = faces[face][1];
+        const auto& v = faces[face][2];
+        for (size_t corner = 0; corner < 4; ++corner) {
+            size_t vertex = 4 * face + corner;
+            for (size_t c = 0; c < 3; ++c) {
+                mesh.positions[3 * vertex + c] = n[c] + corners[corner][0] * u[c] + corners[corner][1] * v[c];
+                mesh.normals[3 * vertex + c] = n[c];
+            }
+            mesh.texcoords[2 * vertex] = corners[corner][0] > 0 ? 1.0f : 0.0f;
+            mesh.texcoords[2 * vertex + 1] = corners[corner][1] > 0 ? 1.0f : 0.0f;
+        }
+        const uint16_t quad[6] = {0, 1, 2, 0, 2, 3};
+        for (size_t i = 0; i < 6; ++i) {
+            mesh.indices[6 * face + i] = uint16_t(4 * face + quad[i]);
+        }
+    }
+    return mesh;
+}
+
+
+// Corners on the axes at distance 1. Faces have their own corners for flat normals.
+constexpr IndexedMesh<24, 24> octahedron() {
+    constexpr float FACE_NORMAL = 0.57735026918962576f;  // 1 / sqrt(3)
+
+    IndexedMesh<24, 24> mesh{};
+    for (size_t face = 0; face < 8; ++face) {
+        float sign[3] = {face & 1 ? -1.0f : 1.0f, face & 2 ? -1.0f : 1.0f, face & 4 ? -1.0f : 1.0f};
+        // mirroring an odd number of axes flips the winding, swap two corners back
+        size_t axes[3] = {0, 1, 2};
+        if (sign[0] * sign[1] * sign[2] < 0) {
+            axes[1] = 2;
+            axes[2] = 1;
+        }
+        for (size_t corner = 0; corner < 3; ++corner) {
+            size_t vertex = 3 * face + corner;
+            mesh.positions[3 * vertex + axes[corner]] = sign[axes[corner]];
+            for (size_t c = 0; c < 3; ++c) {
+                mesh.normals[3 * vertex + c] = sign[c] * FACE_NORMAL;
+            }
+            mesh.texcoords[2 * vertex] = corner == 1 ? 1.0f : 0.0f;
+            mesh.texcoords[2 * vertex + 1] = corner == 2 ? 1.0f : 0.0f;
+            mesh.indices[vertex] = uint16_t(vertex);
+        }
+    }
+    return mesh;
+}
+
+
+// Unit sphere of Stacks bands from +z to -z and Slices segments around z,
+// with a texture seam where the first and last columns meet.
+template <size_t Stacks, size_t Slices>
+constexpr IndexedMesh<(Stacks + 1) * (Slices + 1), 6 * Stacks * Slices> sphere() {
+    static_assert(Stacks >= 2 && Slices >= 3, "too coarse for a sphere");
+
+    IndexedMesh<(Stacks + 1) * (Slices + 1), 6 * Stacks * Slices> mesh{};
+    for (size_t i = 0; i <= Stacks; ++i) {
+        double theta = detail::PI * i / Stacks;
+        // exact at the poles, so their corners coincide
+        bool pole = i == 0 || i == Stacks;
+        double ring = pole ? 0.0 : detail::sin(theta);
+        double z = pole ? (i == 0 ? 1.0 : -1.0) : detail::cos(theta);
+        for (size_t j = 0; j <= Slices; ++j) {
+            // the last column repeats the first one's position, only its uv differs
+            double phi = 2 * detail::PI * (j % Slices) / Slices + detail::PI;
+            size_t vertex = i * (Slices + 1) + j;
+            float point[3] = {
+                float(detail::cos(phi) * ring),
+                float(detail::sin(phi) * ring),
+                float(z)
+            };
+            for (size_t c = 0; c < 3; ++c) {
+                mesh.positions[3 * vertex + c] = point[c];
+                mesh.normals[3 * vertex + c] = point[c];
+            }
+            mesh.texcoords[2 * vertex] = float(j) / Slices;
+            mesh.texcoords[2 * vertex + 1] = 1.0f - float(i) / Stacks;
+        }
+    }
+    // two triangles per band segment, at the poles one of them is degenerate
+    size_t index = 0;
+    for (size_t i = 0; i < Stacks; ++i) {
+        for (size_t j = 0; j < Slices; ++j) {
+            uint16_t a = uint16_t(i * (Slices + 1) + j);
+            uint16_t b = uint16_t(a + Slices + 1);
+            const uint16_t quad[6] = {a, uint16_t(b + 1), uint16_t(a + 1), a, b, uint16_t(b + 1)};
+            for (size_t k = 0; k < 6; ++k) {
+                mesh.indices[index++] = quad[k];
+            }
+        }
+    }
+    return mesh;
+}
+
+
+inline constexpr auto CUBE = cube();
+inline constexpr auto OCTAHEDRON = octahedron();
+
+}  // namespace Primitives
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "render_queue.hpp"
+#include "snapshot.hpp"
+
+// Preprocessed mesh written by tools/meshbake.
+//
+// Layout: Header, then vertices and uint32 indices, 8-byte aligned.
+// Vertices are deduplicated and triangles are ordered for the
+// post-transform vertex cache, so the data goes to the GPU as is.
+namespace BakedMesh {
+
+const uint32_t MAGIC = 0x4D484347;  // "GCHM"
+const uint32_t VERSION = 1;
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t vertex_offset;
+    uint32_t index_count;
+    uint32_t index_offset;
+    float center[3];  // bounding sphere
+    float radius;
+};
+
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+static_assert(std::is_trivially_copyable<Header>::value, "baked mesh records must be POD");
+static_assert(sizeof(Header) == 40, "baked mesh header layout changed, bump VERSION");
+static_assert(sizeof(Vertex) == 32, "baked mesh vertex layout changed, bump VERSION");
+
+
+// Validated view over a mapped .mesh file, nothing is copied. Every index
+// refers to a vertex of the file.
+class View {
+    const Header* _header = nullptr;
+    const uint8_t* _data = nullptr;
+public:
+    View(const uint8_t* data, size_t size) {
+        if (!data || size < sizeof(Header)) {
+            return;
+        }
+        auto header = reinterpret_cast<const Header*>(data);
+        if (header->magic != MAGIC || header->version != VERSION || header->index_count % 3 != 0) {
+            return;
+        }
+        if (header->vertex_offset % 8 != 0 || header->vertex_offset > size
+            || header->vertex_count > (size - header->vertex_offset) / sizeof(Vertex)
+            || header->index_offset % 8 != 0 || header->index_offset > size
+            || header->index_count > (size - header->index_offset) / sizeof(uint32_t)) {
+            return;
+        }
+        auto indices = reinterpret_cast<const uint32_t*>(data + header->index_offset);
+        for (uint32_t i = 0; i < header->index_count; ++i) {
+            if (indices[i] >= header->vertex_count) {
+                return;
+            }
+        }
+        _header = header;
+        _data = data;
+    }
+
+    explicit View(const Snapshot::MappedFile& file) : View(file.data(), file.size()) {}
+
+    bool valid() const {
+        return _header != nullptr;
+    }
+
+    const Header& header() const {
+        return *_header;
+    }
+
+    Snapshot::Span<Vertex> vertices() const {
+        return {reinterpret_cast<const Vertex*>(_data + _header->vertex_offset), _header->vertex_count};
+    }
+
+    Snapshot::Span<uint32_t> indices() const {
+        return {reinterpret_cast<const uint32_t*>(_data + _header->index_offset), _header->index_count};
+    }
+};
+
+}  // namespace BakedMesh
+
+
+// Static object drawn from a baked mesh. Vertices and indices go to the GPU
+// as baked, in vertex cache order, and are drawn with glDrawElements; winding
+// was settled by meshbake.
+class Model {
+public:
+    glm::vec3 center;
+    GLfloat radius = 0;
+    Mesh mesh;
+    BufferRange range;  // indices of the mesh
+
+    explicit Model(const BakedMesh::View& baked, const glm::vec3& color=glm::vec3(0.6f, 0.6f, 0.6f)) {
+        auto vertices = baked.vertices();
+        auto indices = baked.indices();
+        mesh.upload_indexed(vertices.data, vertices.size, sizeof(BakedMesh::Vertex),
+            offsetof(BakedMesh::Vertex, uv), indices.data, indices.size, color);
+        range = BufferRange{0, GLsizei(indices.size)};
+        const float* c = baked.header().center;
+        center = glm::vec3(c[0], c[1], c[2]);
+        radius = baked.header().radius;
+    }
+
+    // called explicitly, like Mesh::release()
+    void release() {
+        mesh.release();
+    }
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simulation.hpp"
+#include "timing.hpp"
+#include "parallel.hpp"
+#include "log.hpp"
+
+// Many independent worlds in one process, for balancing and regression runs.
+//
+// Worlds are spread over a WorkerPool one per job and share nothing but the
+// read-only floor, so throughput follows the core count and there is no
+// window, GL context or shader compile per world. World i is
+// seeded with seed + i and gets its own serial pool for the parallel parts of
+// its ticks, as pool jobs cannot start pool jobs of their own. Nobody watches
+// the worlds, so they have no particles.
+namespace Batch {
+
+struct Settings {
+    size_t worlds = 1;
+    size_t ticks = 3600;  // per world
+    double tick_rate = 60;
+    Simulation::Settings world;  // seed of the first world, the others count up
+};
+
+struct WorldResult {
+    uint64_t seed = 0;
+    Simulation::Stats stats;
+    size_t targets = 0;  // alive at the end
+    double seconds = 0;  // wall time of this world
+};
+
+struct Report {
+    std::vector<WorldResult> worlds;
+    double seconds = 0;  // wall time of the batch
+    uint64_t ticks = 0;
+
+    uint64_t total(uint64_t Simulation::Stats::* field) const {
+        uint64_t sum = 0;
+        for (const auto& world : worlds) {
+            sum += world.stats.*field;
+        }
+        return sum;
+    }
+};
+
+
+// Input of a player that turns on the spot and fires whenever it can.
+inline TickInput autopilot(float dt) {
+    TickInput input;
+    input.held[GLFW_KEY_RIGHT] = dt;
+    input.held[GLFW_KEY_SPACE] = dt;
+    return input;
+}
+
+
+inline Report run(const Settings& settings, const Floor& floor, WorkerPool& pool) {
+    Report report;
+    report.worlds.resize(settings.worlds);
+    const float dt = float(1.0 / settings.tick_rate);
+    Clock clock;
+    pool.parallel_for(settings.worlds, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double start = clock.now();
+            Simulation::Settings world_settings = settings.world;
+            world_settings.seed = settings.world.seed + i;
+            world_settings.particle_capacity = 0;
+            world_settings.world_dir.clear();  // cell files of worlds would collide
+
+            WorkerPool serial(0);
+            GeometryCache tiles;
+            Simulation world(world_settings, floor, tiles, serial);
+            TickInput input = autopilot(dt);
+            for (size_t tick = 0; tick < settings.ticks; ++tick) {
+                world.stream();
+                world.tick(dt, input);
+            }
+
+            WorldResult& result = report.worlds[i];
+            result.seed = world_settings.seed;
+            result.stats = world.stats();
+            result.targets = world.targets.size();
+            result.seconds = clock.now() - start;
+        }
+    });
+    report.seconds = clock.now();
+    report.ticks = report.total(&Simulation::Stats::ticks);
+    return report;
+}
+
+
+inline void log_report(const Report& report) {
+    for (const auto& world : report.worlds) {
+        LOG_DEBUG("world %llu: %llu ticks in %.3f s, %llu spawned, %llu expired, %llu fired, %llu hits, "
+            "%zu targets at most, %zu at the end",
+            (unsigned long long)world.seed, (unsigned long long)world.stats.ticks, world.seconds,
+            (unsigned long long)world.stats.spawned, (unsigned long long)world.stats.expired,
+            (unsigned long long)world.stats.fired, (unsigned long long)world.stats.collisions,
+            world.stats.peak_targets, world.targets);
+    }
+    if (report.worlds.empty()) {
+        return;
+    }
+    uint64_t fired = report.total(&Simulation::Stats::fired);
+    uint64_t hits = report.total(&Simulation::Stats::collisions);
+    auto by_hits = [](const WorldResult& a, const WorldResult& b) {
+        return a.stats.collisions < b.stats.collisions;
+    };
+    auto fewest = std::min_element(report.worlds.begin(), report.worlds.end(), by_hits);
+    auto most = std::max_element(report.worlds.begin(), report.worlds.end(), by_hits);
+    size_t peak = 0;
+    for (const auto& world : report.worlds) {
+        peak = std::max(peak, world.stats.peak_targets);
+    }
+    LOG_INFO("%zu worlds, %llu ticks in %.3f s: %.0f ticks/s",
+        report.worlds.size(), (unsigned long long)report.ticks, report.seconds,
+        report.ticks / std::max(report.seconds, 1e-9));
+    LOG_INFO("spawned %llu, expired %llu, fired %llu, hits %llu (%.1f%% of shots), %zu targets at most",
+        (unsigned long long)report.total(&Simulation::Stats::spawned),
+        (unsigned long long)report.total(&Simulation::Stats::expired),
+        (unsigned long long)fired, (unsigned long long)hits, fired ? 100.0 * hits / fired : 0.0, peak);
+    LOG_INFO("hits per world: %llu to %llu (seeds %llu and %llu)",
+        (unsigned long long)fewest->stats.collisions, (unsigned long long)most->stats.collisions,
+        (unsigned long long)fewest->seed, (unsigned long long)most->seed);
+    Log::result("batch worlds=%zu ticks=%llu seconds=%.3f ticks_per_second=%.1f hits=%llu",
+        report.worlds.size(), (unsigned long long)report.ticks, report.seconds,
+        report.ticks / std::max(report.seconds, 1e-9), (unsigned long long)hits);
+}
+
+}  // namespace Batch
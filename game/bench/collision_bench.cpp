@@ -0,0 +1,103 @@
+// Cost of the fireball/target collision pass per candidate pair.
+//
+// usage: collision_bench [targets] [fireballs] [rounds]
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../objects.hpp"
+#include "../collision.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t target_count = argc > 1 ? atoi(argv[1]) : 2000;
+    size_t fireball_count = argc > 2 ? atoi(argv[2]) : 200;
+    size_t rounds = argc > 3 ? atoi(argv[3]) : 100;
+
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+    auto random_vec = [&](float scale) {
+        return glm::vec3(uniform(generator) - 0.5f, uniform(generator) - 0.5f, uniform(generator) - 0.5f) * scale;
+    };
+
+    // same sizes and speeds as the game, packed into a 20 unit cube
+    std::vector<Collision::Obb> boxes;
+    std::vector<glm::vec3> box_motion;
+    std::vector<Collision::Aabb> box_bounds;
+    for (size_t i = 0; i < target_count; ++i) {
+        float radius = 0.1f + 0.05f * uniform(generator);
+        glm::vec3 angle = random_vec(2 * 3.14f);
+        Collision::Obb box;
+        box.center = random_vec(20);
+        box.axes[0] = Triangle::rotate(glm::vec3(1, 0, 0), angle);
+        box.axes[1] = Triangle::rotate(glm::vec3(0, 1, 0), angle);
+        box.axes[2] = Triangle::rotate(glm::vec3(0, 0, 1), angle);
+        box.half = glm::vec3(radius, radius, radius);
+        boxes.push_back(box);
+        box_motion.push_back(random_vec(0.02f));
+        box_bounds.push_back(Collision::swept_bounds(box.center, box_motion.back(), radius * sqrt(3.0f)));
+    }
+    std::vector<glm::vec3> spheres;
+    std::vector<glm::vec3> sphere_motion;
+    std::vector<Collision::Aabb> sphere_bounds;
+    const float sphere_radius = 0.5f;
+    for (size_t j = 0; j < fireball_count; ++j) {
+        spheres.push_back(random_vec(20));
+        sphere_motion.push_back(glm::normalize(random_vec(1)) * 0.5f);
+        sphere_bounds.push_back(Collision::swept_bounds(spheres.back(), sphere_motion.back(), sphere_radius));
+    }
+
+    Collision::BroadPhase broad_phase;
+    Collision::SweptSphereObbBatch batch;
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    double broad_ns = 0;
+    double narrow_ns = 0;
+    size_t candidates = 0;
+    size_t hits = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        auto start = Clock::now();
+        broad_phase.find_pairs(box_bounds, sphere_bounds, pairs);
+        broad_ns += elapsed_ns(start);
+
+        start = Clock::now();
+        batch.clear();
+        for (const auto& pair : pairs) {
+            batch.add(boxes[pair.first], box_motion[pair.first],
+                spheres[pair.second], sphere_motion[pair.second], sphere_radius, pair.first, pair.second);
+        }
+        batch.solve();
+        narrow_ns += elapsed_ns(start);
+
+        candidates += pairs.size();
+        for (size_t k = 0; k < batch.size(); ++k) {
+            hits += batch.time(k) <= 1.0f;
+        }
+    }
+
+    // the batch must agree with the scalar sweep
+    size_t mismatches = 0;
+    for (size_t k = 0; k < batch.size(); ++k) {
+        Collision::Obb box = boxes[batch.box_id[k]];
+        glm::vec3 motion = sphere_motion[batch.sphere_id[k]] - box_motion[batch.box_id[k]];
+        float t = Collision::sweep_sphere_obb(spheres[batch.sphere_id[k]], motion, sphere_radius, box);
+        mismatches += (t <= 1.0f) != (batch.time(k) <= 1.0f);
+    }
+
+    size_t all_pairs = target_count * fireball_count;
+    printf("targets: %zu, fireballs: %zu, rounds: %zu\n", target_count, fireball_count, rounds);
+    printf("candidates per round: %.1f of %zu pairs, hits per round: %.1f\n",
+        double(candidates) / rounds, all_pairs, double(hits) / rounds);
+    printf("broad phase: %.1f us per round\n", broad_ns / rounds / 1000);
+    printf("narrow phase: %.1f ns per candidate pair\n", candidates ? narrow_ns / candidates : 0.0);
+    printf("total: %.1f ns per candidate pair\n", candidates ? (broad_ns + narrow_ns) / candidates : 0.0);
+    printf("mismatches against scalar sweep: %zu\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+// Cost of updating and drawing the particle system at a steady particle count.
+//
+// usage: particle_bench [particles] [frames] [threads]
+// threads counts workers besides the main thread, by default one per remaining core.
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "../objects.hpp"
+#include "../particles.hpp"
+#include "../parallel.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Fills the pool, then runs frames at 60 Hz re-emitting what died.
+void run(size_t particle_count, size_t frames, size_t threads) {
+    WorkerPool pool(threads);
+    ParticleSystem particles(particle_count, 42);
+    Buffer buffer;
+
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<float> uniform(-10.0f, 10.0f);
+    const float dt = 1.0f / 60;
+    ParticleEmitter emitter{glm::vec3(0, 2, 0), 1.0f, glm::vec3(1.0f, 0.5f, 0.1f), 2.0f};
+    auto refill = [&] {
+        while (particles.size() < particle_count) {
+            glm::vec3 position(uniform(generator), uniform(generator), uniform(generator));
+            particles.emit(position, emitter, std::min<size_t>(1000, particle_count - particles.size()));
+        }
+    };
+    refill();
+
+    double update_ms = 0;
+    double draw_ms = 0;
+    double emit_ms = 0;
+    for (size_t frame = 0; frame < frames; ++frame) {
+        auto start = Clock::now();
+        refill();
+        emit_ms += elapsed_ms(start);
+
+        start = Clock::now();
+        particles.update(dt, pool);
+        update_ms += elapsed_ms(start);
+
+        start = Clock::now();
+        buffer.clear();
+        particles.draw(buffer, pool);
+        draw_ms += elapsed_ms(start);
+    }
+    double total = (update_ms + draw_ms + emit_ms) / frames;
+    printf("%zu particles, %zu threads: update %.2f ms, draw %.2f ms, emit %.2f ms, "
+           "%.2f ms per frame, %.0f M particles/s\n",
+        particle_count, pool.size(), update_ms / frames, draw_ms / frames, emit_ms / frames,
+        total, particle_count / total / 1000);
+}
+
+int main(int argc, char** argv) {
+    size_t particle_count = argc > 1 ? atoi(argv[1]) : 1000000;
+    size_t frames = argc > 2 ? atoi(argv[2]) : 120;
+    size_t threads = argc > 3 ? atoi(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u) - 1;
+
+    run(particle_count, frames, 0);
+    if (threads > 0) {
+        run(particle_count, frames, threads);
+    }
+    return 0;
+}
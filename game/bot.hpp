@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "simulation.hpp"
+#include "log.hpp"
+
+// Direction to fire from origin at shot_speed to meet a target at position
+// moving at speed: the positive root of |offset + speed t| = shot_speed t.
+// Targets are far slower than fireballs, so there always is one.
+inline glm::vec3 lead_direction(const glm::vec3& origin, const glm::vec3& position, const glm::vec3& speed,
+    float shot_speed) {
+    glm::vec3 offset = position - origin;
+    float a = glm::dot(speed, speed) - shot_speed * shot_speed;
+    float b = 2 * glm::dot(offset, speed);
+    float c = glm::dot(offset, offset);
+    float t = 0;
+    if (a < 0) {
+        // c / a < 0, the roots have opposite signs
+        t = (-b - std::sqrt(b * b - 4 * a * c)) / (2 * a);
+    }
+    glm::vec3 aim = offset + speed * t;
+    float length = glm::length(aim);
+    return length > 1e-6f ? aim / length : glm::vec3(0, 0, 1);
+}
+
+
+// A scripted player for stress runs.
+//
+// Before every tick it tops the live targets up to a goal that grows over
+// time and fires at a fixed rate, with lead, at the targets nearest to the
+// player. The rate is not held to FIREBALL_COOLDOWN, so the collision pass,
+// the instance buffers and the particles can be loaded far past what a
+// person holding space produces. The player does not move. Everything it does
+// follows from the world's state, so runs with the same seed replay exactly.
+class Bot {
+public:
+    static constexpr size_t AIM_SPREAD = 8;  // shots go round this many nearest targets
+
+    struct Settings {
+        float fire_rate = 20;        // fireballs per second
+        size_t start_targets = 500;  // live targets from the start
+        float ramp = 250;            // live targets added to the goal per second
+        size_t max_targets = 1000000;
+    };
+
+private:
+    Settings _settings;
+    double _start_time;
+    float _shot_budget = 0;  // fireballs owed by the fire rate
+    uint64_t _shots = 0;
+    std::vector<std::pair<float, uint32_t>> _nearest;  // squared distance and target id
+
+public:
+    Bot(const Settings& settings, double start_time) : _settings(settings), _start_time(start_time) {}
+
+    size_t goal(double time) const {
+        double goal = _settings.start_targets + _settings.ramp * std::max(time - _start_time, 0.0);
+        return size_t(std::min(goal, double(_settings.max_targets)));
+    }
+
+    // Call before each tick of the world. Returns the fireballs fired.
+    size_t drive(Simulation& sim, float dt) {
+        MEMORY_TAG(TAG_ENTITY);
+        size_t target_count = goal(sim.time);
+        if (sim.targets.size() < target_count) {
+            sim.spawn(target_count - sim.targets.size());
+        }
+
+        _shot_budget += _settings.fire_rate * dt;
+        size_t shots = size_t(_shot_budget);
+        _shot_budget -= shots;
+        if (shots == 0 || sim.targets.empty()) {
+            return 0;
+        }
+        // a target keeps being nearest while shots are in flight to it, so the
+        // shots are spread over the few nearest instead of all chasing one
+        const glm::vec3 origin = sim.muzzle();
+        _nearest.clear();
+        for (size_t i = 0; i < sim.targets.size(); ++i) {
+            glm::vec3 offset = sim.targets.center(i) - origin;
+            _nearest.emplace_back(glm::dot(offset, offset), uint32_t(i));
+        }
+        size_t spread = std::min(AIM_SPREAD, _nearest.size());
+        std::partial_sort(_nearest.begin(), _nearest.begin() + spread, _nearest.end());
+        for (size_t shot = 0; shot < shots; ++shot) {
+            uint32_t id = _nearest[_shots++ % spread].second;
+            sim.fire(lead_direction(origin, sim.targets.center(id), sim.targets.speed(id), FIREBALL_SPEED));
+        }
+        return shots;
+    }
+};
+
+
+// Frame time against the number of live entities, for runs that ramp the load.
+//
+// Frames are put in bins of width entities. The knee is where frame time
+// starts growing faster than the load: the bin furthest below the straight
+// line from the first bin to the last, with both axes scaled to [0, 1]. Bins
+// of fewer than MIN_FRAMES frames are too noisy to take part.
+class LoadCurve {
+public:
+    static constexpr size_t MIN_FRAMES = 10;
+    static constexpr size_t NONE = size_t(-1);
+
+    struct Bin {
+        size_t frames = 0;
+        double time = 0;  // seconds, sum
+        double max_time = 0;
+    };
+
+private:
+    size_t _width;
+    std::vector<Bin> _bins;
+
+    double average_ms(size_t bin) const {
+        return 1000 * _bins[bin].time / _bins[bin].frames;
+    }
+
+    // entities in the middle of a bin
+    double load(size_t bin) const {
+        return (bin + 0.5) * _width;
+    }
+
+public:
+    explicit LoadCurve(size_t width=1000) : _width(std::max<size_t>(width, 1)) {}
+
+    size_t width() const {
+        return _width;
+    }
+
+    const std::vector<Bin>& bins() const {
+        return _bins;
+    }
+
+    void add(size_t entities, double frame_time) {
+        size_t bin = entities / _width;
+        if (bin >= _bins.size()) {
+            _bins.resize(bin + 1);
+        }
+        _bins[bin].frames += 1;
+        _bins[bin].time += frame_time;
+        _bins[bin].max_time = std::max(_bins[bin].max_time, frame_time);
+    }
+
+    // Bin of the knee, NONE when frame time does not bend upwards over the run.
+    size_t knee() const {
+        std::vector<size_t> used;
+        for (size_t bin = 0; bin < _bins.size(); ++bin) {
+            if (_bins[bin].frames >= MIN_FRAMES) {
+                used.push_back(bin);
+            }
+        }
+        if (used.size() < 3) {
+            return NONE;
+        }
+        double x0 = load(used.front());
+        double y0 = average_ms(used.front());
+        double x_range = load(used.back()) - x0;
+        double y_range = average_ms(used.back()) - y0;
+        if (y_range <= 0) {
+            return NONE;
+        }
+        size_t result = NONE;
+        double furthest = 0;
+        for (size_t bin : used) {
+            double below = (load(bin) - x0) / x_range - (average_ms(bin) - y0) / y_range;
+            if (below > furthest) {
+                furthest = below;
+                result = bin;
+            }
+        }
+        return result;
+    }
+
+    // One line per bin, then the knee and where frames first take longer than budget seconds.
+    void log_report(double budget) const {
+        size_t over_budget = NONE;
+        for (size_t bin = 0; bin < _bins.size(); ++bin) {
+            const Bin& b = _bins[bin];
+            if (b.frames == 0) {
+                continue;
+            }
+            double seconds = std::max(b.time, 1e-9);
+            LOG_INFO("load %zu-%zu entities: %zu frames, %.2f ms avg / %.2f ms max, %.1f fps, %.2f M entity frames/s",
+                bin * _width, (bin + 1) * _width, b.frames, average_ms(bin), 1000 * b.max_time,
+                b.frames / seconds, load(bin) * b.frames / seconds / 1e6);
+            if (over_budget == NONE && b.frames >= MIN_FRAMES && b.time / b.frames > budget) {
+                over_budget = bin;
+            }
+        }
+        size_t bend = knee();
+        if (bend == NONE) {
+            LOG_INFO("load: no knee, frame time grows no faster than the load up to %zu entities",
+                _bins.size() * _width);
+        } else {
+            // slopes from the first used bin to the knee and from the knee to the last used bin
+            size_t first = 0;
+            while (_bins[first].frames < MIN_FRAMES) {
+                ++first;
+            }
+            size_t last = _bins.size() - 1;
+            while (_bins[last].frames < MIN_FRAMES) {
+                --last;
+            }
+            double before = bend > first
+                ? 1000 * (average_ms(bend) - average_ms(first)) / (load(bend) - load(first)) : 0;
+            double after = 1000 * (average_ms(last) - average_ms(bend)) / (load(last) - load(bend));
+            LOG_INFO("load: knee at %zu-%zu entities, %.2f ms, frame time grows %.3f ms per 1000 entities "
+                "before and %.3f after", bend * _width, (bend + 1) * _width, average_ms(bend), before, after);
+        }
+        if (over_budget == NONE) {
+            LOG_INFO("load: frames stayed within %.2f ms", 1000 * budget);
+        } else {
+            LOG_INFO("load: frames over %.2f ms from %zu entities", 1000 * budget, over_budget * _width);
+        }
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Perspective camera with cached matrices.
+// The projection is rebuilt only when its parameters change and the view only
+// when the camera moves; view-projection and frustum planes follow either.
+// Cameras are independent, so several views (split screen, offscreen
+// benchmark views) can render the same frame.
+class Camera {
+    float _fov;
+    float _aspect;
+    float _near;
+    float _far;
+    glm::vec3 _position = glm::vec3(0, 0, 0);
+    glm::vec3 _direction = glm::vec3(0, 0, 1);
+    glm::vec3 _up = glm::vec3(0, 1, 0);
+
+    glm::mat4 _projection;
+    glm::mat4 _view;
+    glm::mat4 _view_projection;
+    glm::vec4 _planes[6];  // left, right, bottom, top, near, far; normals point inside
+
+    bool _projection_dirty = true;
+    bool _view_dirty = true;
+    bool _planes_dirty = true;
+
+    void update() {
+        if (!_projection_dirty && !_view_dirty) {
+            return;
+        }
+        if (_projection_dirty) {
+            _projection = glm::perspective(_fov, _aspect, _near, _far);
+        }
+        if (_view_dirty) {
+            _view = glm::lookAt(_position, _position + _direction, _up);
+        }
+        _view_projection = _projection * _view;
+        _projection_dirty = false;
+        _view_dirty = false;
+        _planes_dirty = true;
+    }
+
+    // Gribb & Hartmann: planes are sums and differences of the matrix rows
+    void update_planes() {
+        update();
+        if (!_planes_dirty) {
+            return;
+        }
+        const glm::mat4& m = _view_projection;
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i) {
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        }
+        for (int i = 0; i < 3; ++i) {
+            _planes[2 * i] = rows[3] + rows[i];
+            _planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (auto& plane : _planes) {
+            plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+        }
+        _planes_dirty = false;
+    }
+
+public:
+    // fov as passed to glm::perspective
+    Camera(float fov=45.0f, float aspect=4.0f / 3.0f, float near=0.1f, float far=100.0f)
+        : _fov(fov), _aspect(aspect), _near(near), _far(far) {}
+
+    void set_perspective(float fov, float aspect, float near, float far) {
+        if (fov != _fov || aspect != _aspect || near != _near || far != _far) {
+            _fov = fov;
+            _aspect = aspect;
+            _near = near;
+            _far = far;
+            _projection_dirty = true;
+        }
+    }
+
+    void set_aspect(float aspect) {
+        set_perspective(_fov, aspect, _near, _far);
+    }
+
+    void look(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& up=glm::vec3(0, 1, 0)) {
+        if (position != _position || direction != _direction || up != _up) {
+            _position = position;
+            _direction = direction;
+            _up = up;
+            _view_dirty = true;
+        }
+    }
+
+    const glm::vec3& position() const {
+        return _position;
+    }
+
+    const glm::mat4& projection() {
+        update();
+        return _projection;
+    }
+
+    const glm::mat4& view() {
+        update();
+        return _view;
+    }
+
+    const glm::mat4& view_projection() {
+        update();
+        return _view_projection;
+    }
+
+    bool sphere_visible(const glm::vec3& center, float radius) {
+        update_planes();
+        for (const auto& plane : _planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
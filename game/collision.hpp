@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+namespace Collision {
+
+// returned by sweeps that do not hit during the tick
+const float NO_HIT = 2.0f;
+
+
+// Oriented box: center, orthonormal axes and half extents along them.
+struct Obb {
+    glm::vec3 center;
+    glm::vec3 axes[3];
+    glm::vec3 half;
+
+    glm::vec3 to_local(const glm::vec3& point) const {
+        glm::vec3 d = point - center;
+        return glm::vec3(glm::dot(d, axes[0]), glm::dot(d, axes[1]), glm::dot(d, axes[2]));
+    }
+
+    glm::vec3 to_local_direction(const glm::vec3& direction) const {
+        return glm::vec3(glm::dot(direction, axes[0]), glm::dot(direction, axes[1]), glm::dot(direction, axes[2]));
+    }
+};
+
+
+// distance from a point in box space to an axis aligned box of given half extents
+inline float box_distance(const glm::vec3& local, const glm::vec3& half) {
+    float dx = std::max(std::fabs(local.x) - half.x, 0.0f);
+    float dy = std::max(std::fabs(local.y) - half.y, 0.0f);
+    float dz = std::max(std::fabs(local.z) - half.z, 0.0f);
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+
+// First time in [0, 1] at which a sphere moving from start by motion touches the box.
+// The slab test against the box grown by radius bounds the contact interval,
+// the exact rounded-box contact is then found on it: distance to a convex
+// shape is convex along a segment, so a ternary search finds its minimum
+// and bisection finds the entry point.
+inline float sweep_sphere_obb(const glm::vec3& start, const glm::vec3& motion, float radius, const Obb& box) {
+    glm::vec3 p = box.to_local(start);
+    glm::vec3 m = box.to_local_direction(motion);
+
+    float t_enter = 0.0f;
+    float t_exit = 1.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = box.half[axis] + radius;
+        if (std::fabs(m[axis]) < 1e-12f) {
+            if (std::fabs(p[axis]) > extent) {
+                return NO_HIT;
+            }
+            continue;
+        }
+        float t0 = (-extent - p[axis]) / m[axis];
+        float t1 = (extent - p[axis]) / m[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        t_enter = std::max(t_enter, t0);
+        t_exit = std::min(t_exit, t1);
+        if (t_enter > t_exit) {
+            return NO_HIT;
+        }
+    }
+
+    auto gap = [&](float t) {
+        return box_distance(p + m * t, box.half) - radius;
+    };
+    if (gap(t_enter) <= 0) {
+        return t_enter;
+    }
+
+    // only the rounded edges and corners are left
+    float lo = t_enter;
+    float hi = t_exit;
+    for (int i = 0; i < 32; ++i) {
+        float a = lo + (hi - lo) / 3;
+        float b = hi - (hi - lo) / 3;
+        if (gap(a) < gap(b)) {
+            hi = b;
+        } else {
+            lo = a;
+        }
+    }
+    float t_min = (lo + hi) / 2;
+    if (gap(t_min) > 0) {
+        return NO_HIT;
+    }
+    lo = t_enter;
+    hi = t_min;
+    for (int i = 0; i < 32; ++i) {
+        float mid = (lo + hi) / 2;
+        if (gap(mid) > 0) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+
+// Axis aligned bounds of an object over the whole tick.
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+inline Aabb swept_bounds(const glm::vec3& start, const glm::vec3& motion, float radius) {
+    glm::vec3 end = start + motion;
+    glm::vec3 r(radius, radius, radius);
+    return Aabb{glm::min(start, end) - r, glm::max(start, end) + r};
+}
+
+
+// Sort and sweep along x between two sets of bounds, pairs only cross the sets.
+// Output pairs are (index in first, index in second).
+class BroadPhase {
+    struct Entry {
+        float min_x;
+        uint32_t id;
+        bool in_first;
+    };
+    std::vector<Entry> _entries;
+    std::vector<uint32_t> _active_first;
+    std::vector<uint32_t> _active_second;
+
+    static bool overlap_yz(const Aabb& a, const Aabb& b) {
+        return a.min.y <= b.max.y && b.min.y <= a.max.y
+            && a.min.z <= b.max.z && b.min.z <= a.max.z;
+    }
+
+    // drops entries that end before x and tests the rest against the new one
+    static void scan(std::vector<uint32_t>& active, const std::vector<Aabb>& bounds,
+        const Aabb& box, float x, uint32_t id, bool box_in_first,
+        std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
+        size_t kept = 0;
+        for (size_t i = 0; i < active.size(); ++i) {
+            const Aabb& other = bounds[active[i]];
+            if (other.max.x < x) {
+                continue;
+            }
+            active[kept++] = active[i];
+            if (overlap_yz(box, other)) {
+                pairs.emplace_back(box_in_first ? id : active[i], box_in_first ? active[i] : id);
+            }
+        }
+        active.resize(kept);
+    }
+public:
+    void find_pairs(const std::vector<Aabb>& first, const std::vector<Aabb>& second,
+        std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
+        pairs.clear();
+        _entries.clear();
+        for (size_t i = 0; i < first.size(); ++i) {
+            _entries.push_back(Entry{first[i].min.x, uint32_t(i), true});
+        }
+        for (size_t i = 0; i < second.size(); ++i) {
+            _entries.push_back(Entry{second[i].min.x, uint32_t(i), false});
+        }
+        std::sort(_entries.begin(), _entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.min_x < rhs.min_x;
+        });
+
+        _active_first.clear();
+        _active_second.clear();
+        for (const auto& entry : _entries) {
+            if (entry.in_first) {
+                scan(_active_second, second, first[entry.id], entry.min_x, entry.id, true, pairs);
+                _active_first.push_back(entry.id);
+            } else {
+                scan(_active_first, first, second[entry.id], entry.min_x, entry.id, false, pairs);
+                _active_second.push_back(entry.id);
+            }
+        }
+    }
+};
+
+
+// Narrow phase batch: moving spheres against moving oriented boxes, structure-of-arrays.
+// The first pass is a branch free slab test against the boxes grown by the sphere
+// radius; it settles face contacts and misses for the whole batch at once. Only pairs
+// that enter through a rounded edge or corner go to the exact scalar sweep.
+class SweptSphereObbBatch {
+    std::vector<float> _px, _py, _pz;  // sphere start relative to box center
+    std::vector<float> _mx, _my, _mz;  // sphere motion relative to box motion
+    std::vector<float> _ax, _ay, _az;  // box axes, 3 per pair
+    std::vector<float> _hx, _hy, _hz;  // box half extents
+    std::vector<float> _r;
+    std::vector<float> _t;
+public:
+    // ids of the box and the sphere in each pair
+    std::vector<uint32_t> box_id;
+    std::vector<uint32_t> sphere_id;
+
+    void clear() {
+        for (auto v : {&_px, &_py, &_pz, &_mx, &_my, &_mz, &_ax, &_ay, &_az, &_hx, &_hy, &_hz, &_r, &_t}) {
+            v->clear();
+        }
+        box_id.clear();
+        sphere_id.clear();
+    }
+
+    size_t size() const {
+        return _r.size();
+    }
+
+    void add(const Obb& box, const glm::vec3& box_motion,
+        const glm::vec3& sphere, const glm::vec3& sphere_motion, float radius,
+        uint32_t a_id, uint32_t b_id) {
+        glm::vec3 p = sphere - box.center;
+        glm::vec3 m = sphere_motion - box_motion;
+        _px.push_back(p.x); _py.push_back(p.y); _pz.push_back(p.z);
+        _mx.push_back(m.x); _my.push_back(m.y); _mz.push_back(m.z);
+        for (int k = 0; k < 3; ++k) {
+            _ax.push_back(box.axes[k].x);
+            _ay.push_back(box.axes[k].y);
+            _az.push_back(box.axes[k].z);
+        }
+        _hx.push_back(box.half.x); _hy.push_back(box.half.y); _hz.push_back(box.half.z);
+        _r.push_back(radius);
+        box_id.push_back(a_id);
+        sphere_id.push_back(b_id);
+    }
+
+    void solve() {
+        const size_t n = size();
+        _t.resize(n);
+        const float* px = _px.data(); const float* py = _py.data(); const float* pz = _pz.data();
+        const float* mx = _mx.data(); const float* my = _my.data(); const float* mz = _mz.data();
+        const float* ax = _ax.data(); const float* ay = _ay.data(); const float* az = _az.data();
+        const float* hx = _hx.data(); const float* hy = _hy.data(); const float* hz = _hz.data();
+        const float* r = _r.data();
+        float* t = _t.data();
+
+        for (size_t i = 0; i < n; ++i) {
+            const float half[3] = {hx[i], hy[i], hz[i]};
+            float lp[3];
+            float lm[3];
+            float t_enter = 0.0f;
+            float t_exit = 1.0f;
+            for (int k = 0; k < 3; ++k) {
+                size_t a = 3 * i + k;
+                lp[k] = px[i] * ax[a] + py[i] * ay[a] + pz[i] * az[a];
+                lm[k] = mx[i] * ax[a] + my[i] * ay[a] + mz[i] * az[a];
+                float extent = half[k] + r[i];
+                float safe_m = std::fabs(lm[k]) < 1e-12f ? 1e-12f : lm[k];
+                float t0 = (-extent - lp[k]) / safe_m;
+                float t1 = (extent - lp[k]) / safe_m;
+                t_enter = std::max(t_enter, std::min(t0, t1));
+                t_exit = std::min(t_exit, std::max(t0, t1));
+            }
+            float gap = 0;
+            for (int k = 0; k < 3; ++k) {
+                float d = std::max(std::fabs(lp[k] + lm[k] * t_enter) - half[k], 0.0f);
+                gap += d * d;
+            }
+            bool in_slabs = t_enter <= t_exit;
+            bool touching = gap <= r[i] * r[i];
+            // -1 marks pairs that need the exact sweep
+            t[i] = !in_slabs ? NO_HIT : (touching ? t_enter : -1.0f);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (t[i] < 0) {
+                Obb box;
+                box.center = glm::vec3(0, 0, 0);
+                for (int k = 0; k < 3; ++k) {
+                    box.axes[k] = glm::vec3(ax[3 * i + k], ay[3 * i + k], az[3 * i + k]);
+                }
+                box.half = glm::vec3(hx[i], hy[i], hz[i]);
+                t[i] = sweep_sphere_obb(glm::vec3(px[i], py[i], pz[i]), glm::vec3(mx[i], my[i], mz[i]), r[i], box);
+            }
+        }
+    }
+
+    float time(size_t i) const {
+        return _t[i];
+    }
+};
+
+
+struct Hit {
+    float time;
+    uint32_t first;
+    uint32_t second;
+};
+
+// Earliest contact per object: each object takes part in at most one hit.
+// Ids must be below first_count and second_count respectively.
+inline std::vector<Hit> resolve_hits(std::vector<Hit> hits, size_t first_count, size_t second_count) {
+    std::sort(hits.begin(), hits.end(), [](const Hit& lhs, const Hit& rhs) {
+        return lhs.time < rhs.time;
+    });
+    std::vector<Hit> result;
+    std::vector<bool> used_first(first_count, false);
+    std::vector<bool> used_second(second_count, false);
+    for (const auto& hit : hits) {
+        if (used_first[hit.first] || used_second[hit.second]) {
+            continue;
+        }
+        used_first[hit.first] = true;
+        used_second[hit.second] = true;
+        result.push_back(hit);
+    }
+    return result;
+}
+
+}  // namespace Collision
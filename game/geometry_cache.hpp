@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "objects.hpp"
+#include "render_queue.hpp"
+
+// Vertex storage that persists across frames.
+//
+// Every object keeps a slot in one buffer. Only objects that changed since the
+// last upload are rewritten, and only their ranges are sent to the GPU, so the
+// cost of a frame follows what moved rather than the size of the scene. Freed
+// slots are reused by objects with the same vertex count, so a stream of
+// spawned and despawned targets does not grow the buffer.
+class GeometryCache {
+    Buffer _buffer;
+    Mesh _mesh;
+    GLenum _usage;
+    std::multimap<GLsizei, GLint> _free;  // vertex count -> first vertex of a free slot
+    std::vector<BufferRange> _dirty;
+    size_t _gpu_vertices = 0;  // room in the GPU buffers
+    size_t _uploaded = 0;      // vertices sent by the last upload()
+
+    BufferRange allocate(GLsizei count) {
+        auto it = _free.find(count);
+        if (it != _free.end()) {
+            BufferRange range{it->second, count};
+            _free.erase(it);
+            return range;
+        }
+        return _buffer.allocate(count);
+    }
+
+public:
+    // GL_STATIC_DRAW for geometry written once, GL_DYNAMIC_DRAW for moving objects
+    explicit GeometryCache(GLenum usage=GL_DYNAMIC_DRAW) : _usage(usage) {}
+
+    GeometryCache(const GeometryCache&) = delete;
+    GeometryCache& operator=(const GeometryCache&) = delete;
+
+    // called explicitly, like Mesh::release()
+    void release() {
+        _mesh.release();
+    }
+
+    const Mesh& mesh() const {
+        return _mesh;
+    }
+
+    size_t vertex_count() const {
+        return _buffer.vertex_count();
+    }
+
+    size_t uploaded() const {
+        return _uploaded;
+    }
+
+    // Rewrites the object's slot if it changed, taking a slot on first use.
+    void update(Object& object) {
+        MEMORY_TAG(TAG_MESH);
+        if (!object.dirty) {
+            return;
+        }
+        GLsizei count = GLsizei(object.vertex_count());
+        if (object.slot.count != count) {
+            free(object);
+            object.slot = allocate(count);
+        }
+        object.draw(_buffer, object.slot);
+        _dirty.push_back(object.slot);
+        object.dirty = false;
+    }
+
+    // Gives the slot back, for objects leaving the scene. The stale vertices
+    // stay in the buffer but are no longer drawn.
+    void free(Object& object) {
+        if (object.slot.count > 0) {
+            _free.emplace(object.slot.count, object.slot.first);
+        }
+        object.slot = BufferRange{0, 0};
+        object.dirty = true;
+    }
+
+    // Sends changed ranges to the GPU, merging neighbours into one call.
+    void upload() {
+        _uploaded = 0;
+        size_t count = _buffer.vertex_count();
+        if (count > _gpu_vertices) {
+            // grown: reallocate with room to spare and send everything
+            _gpu_vertices = std::max(count, 2 * _gpu_vertices);
+            _mesh.allocate(_gpu_vertices, _usage);
+            _mesh.upload_range(_buffer, BufferRange{0, GLsizei(count)});
+            _uploaded = count;
+            _dirty.clear();
+            return;
+        }
+
+        std::sort(_dirty.begin(), _dirty.end(), [](const BufferRange& lhs, const BufferRange& rhs) {
+            return lhs.first < rhs.first;
+        });
+        BufferRange pending{0, 0};
+        for (const auto& range : _dirty) {
+            if (pending.count > 0 && range.first <= pending.first + pending.count) {
+                pending.count = std::max(pending.first + pending.count, range.first + range.count) - pending.first;
+                continue;
+            }
+            if (pending.count > 0) {
+                _mesh.upload_range(_buffer, pending);
+                _uploaded += pending.count;
+            }
+            pending = range;
+        }
+        if (pending.count > 0) {
+            _mesh.upload_range(_buffer, pending);
+            _uploaded += pending.count;
+        }
+        _dirty.clear();
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstring>
+
+// Include GLEW
+#include <GL/glew.h>
+
+#ifdef GOCHI_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// Loads GL entry points without the GLX checks glewInit() adds on X11, which
+// fail without a display. Exported by GLEW but only declared in GLEW_MX builds.
+extern "C" GLenum GLEWAPIENTRY glewContextInit(void);
+#endif
+
+#include "log.hpp"
+
+// Offscreen rendering for machines without a display.
+//
+// Creates a surfaceless EGL context (Mesa picks llvmpipe when there is no GPU,
+// or force it with LIBGL_ALWAYS_SOFTWARE=1) and renders into a framebuffer
+// object of the requested size instead of a window.
+class HeadlessContext {
+    int _width = 0;
+    int _height = 0;
+    GLuint _framebuffer = 0;
+    GLuint _color = 0;
+    GLuint _depth = 0;
+#ifdef GOCHI_HAS_EGL
+    EGLDisplay _display = EGL_NO_DISPLAY;
+    EGLContext _context = EGL_NO_CONTEXT;
+
+    static bool has_extension(const char* extensions, const char* name) {
+        return extensions && strstr(extensions, name) != nullptr;
+    }
+
+    // Mesa's surfaceless platform when available, the default display otherwise
+    static EGLDisplay get_display() {
+        const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (has_extension(extensions, "EGL_MESA_platform_surfaceless")) {
+            auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (get_platform_display) {
+                EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if (display != EGL_NO_DISPLAY) {
+                    return display;
+                }
+            }
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    bool create_context() {
+        _display = get_display();
+        EGLint major, minor;
+        if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, &major, &minor)) {
+            LOG_ERROR("Failed to initialize EGL");
+            return false;
+        }
+        if (!has_extension(eglQueryString(_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+            LOG_ERROR("EGL %d.%d has no surfaceless contexts", major, minor);
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            LOG_ERROR("EGL does not support desktop OpenGL");
+            return false;
+        }
+        const EGLint config_attributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, EGL_DONT_CARE,  // the default asks for window surfaces
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint config_count = 0;
+        if (!eglChooseConfig(_display, config_attributes, &config, 1, &config_count) || config_count == 0) {
+            LOG_ERROR("No EGL config for desktop OpenGL");
+            return false;
+        }
+        _context = eglCreateContext(_display, config, EGL_NO_CONTEXT, nullptr);
+        if (_context == EGL_NO_CONTEXT
+            || !eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context)) {
+            LOG_ERROR("Failed to create an EGL context");
+            return false;
+        }
+        glewExperimental = GL_TRUE;
+        if (glewContextInit() != GLEW_OK) {
+            LOG_ERROR("Failed to initialize GLEW");
+            return false;
+        }
+        LOG_INFO("Headless EGL %d.%d, %s, %s", major, minor,
+            reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+            reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        return true;
+    }
+#else
+    bool create_context() {
+        LOG_ERROR("Built without EGL, headless mode is not available");
+        return false;
+    }
+#endif
+
+    bool create_framebuffer() {
+        glGenRenderbuffers(1, &_color);
+        glBindRenderbuffer(GL_RENDERBUFFER, _color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+        glGenRenderbuffers(1, &_depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &_framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depth);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR("Offscreen framebuffer is incomplete: 0x%x", status);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    HeadlessContext() {}
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Makes the context current with the framebuffer bound. Logs why it failed.
+    bool create(int width, int height) {
+        _width = width;
+        _height = height;
+        return create_context() && create_framebuffer();
+    }
+
+    int width() const {
+        return _width;
+    }
+
+    int height() const {
+        return _height;
+    }
+
+    // stands in for swapping buffers: waits until the frame is really rendered
+    void finish_frame() {
+        glFinish();
+    }
+
+    // Called explicitly while the context is still current.
+    void release() {
+        if (_framebuffer) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteFramebuffers(1, &_framebuffer);
+            glDeleteRenderbuffers(1, &_color);
+            glDeleteRenderbuffers(1, &_depth);
+            _framebuffer = _color = _depth = 0;
+        }
+#ifdef GOCHI_HAS_EGL
+        if (_display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (_context != EGL_NO_CONTEXT) {
+                eglDestroyContext(_display, _context);
+            }
+            eglTerminate(_display);
+            _display = EGL_NO_DISPLAY;
+            _context = EGL_NO_CONTEXT;
+        }
+#endif
+    }
+};
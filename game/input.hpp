@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+// Include GLFW
+#include <glfw3.h>
+
+#include "timing.hpp"
+
+// Timestamped input.
+//
+// GLFW callbacks push events into a lock-free single-producer queue; each
+// simulation tick consumes the events that happened before its end and gets
+// how long every key was held inside the tick. A key pressed and released
+// between two frames still counts, and a held key moves the camera by the
+// time it was held whatever the frame time.
+
+struct InputEvent {
+    enum Type { KEY, CURSOR };
+    Type type;
+    double time;
+    int key;
+    int action;
+    double x;
+    double y;
+};
+
+
+// Bounded single-producer single-consumer ring.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+    T _items[CAPACITY];
+    alignas(64) std::atomic<size_t> _head{0};  // written by the producer
+    alignas(64) std::atomic<size_t> _tail{0};  // written by the consumer
+public:
+    bool push(const T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        _items[head & (CAPACITY - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // oldest item or nullptr, stays in the queue until pop()
+    const T* front() const {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &_items[tail & (CAPACITY - 1)];
+    }
+
+    void pop() {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+
+// What a single simulation tick sees.
+struct TickInput {
+    float held[GLFW_KEY_LAST + 1] = {};     // seconds each key was down during the tick
+    int presses[GLFW_KEY_LAST + 1] = {};    // presses that started during the tick
+    double cursor_dx = 0;
+    double cursor_dy = 0;
+
+    bool down(int key) const {
+        return held[key] > 0 || presses[key] > 0;
+    }
+};
+
+
+class Input {
+    const Clock& _clock;
+    SpscQueue<InputEvent, 1024> _events;
+    size_t _dropped = 0;
+
+    // state carried between ticks, consumer side only
+    bool _down[GLFW_KEY_LAST + 1] = {};
+    double _down_since[GLFW_KEY_LAST + 1] = {};
+    bool _has_cursor = false;
+    double _cursor_x = 0;
+    double _cursor_y = 0;
+
+    void push(const InputEvent& event) {
+        if (!_events.push(event)) {
+            ++_dropped;
+        }
+    }
+
+    static void key_callback(GLFWwindow* window, int key, int, int action, int) {
+        auto input = static_cast<Input*>(glfwGetWindowUserPointer(window));
+        if (key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT) {
+            return;
+        }
+        input->push(InputEvent{InputEvent::KEY, input->_clock.now(), key, action, 0, 0});
+    }
+
+    static void cursor_callback(GLFWwindow* window, double x, double y) {
+        auto input = static_cast<Input*>(glfwGetWindowUserPointer(window));
+        input->push(InputEvent{InputEvent::CURSOR, input->_clock.now(), 0, 0, x, y});
+    }
+
+public:
+    explicit Input(const Clock& clock) : _clock(clock) {}
+
+    Input(const Input&) = delete;
+    Input& operator=(const Input&) = delete;
+
+    void attach(GLFWwindow* window) {
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetCursorPosCallback(window, cursor_callback);
+    }
+
+    size_t dropped() const {
+        return _dropped;
+    }
+
+    // Applies events up to tick_end, the tick covers [tick_start, tick_end) of clock time.
+    TickInput consume(double tick_start, double tick_end) {
+        TickInput result;
+        while (const InputEvent* event = _events.front()) {
+            if (event->time > tick_end) {
+                break;
+            }
+            double time = std::max(event->time, tick_start);
+            if (event->type == InputEvent::KEY) {
+                int key = event->key;
+                if (event->action == GLFW_PRESS && !_down[key]) {
+                    _down[key] = true;
+                    _down_since[key] = time;
+                    ++result.presses[key];
+                } else if (event->action == GLFW_RELEASE && _down[key]) {
+                    result.held[key] += float(time - std::max(_down_since[key], tick_start));
+                    _down[key] = false;
+                }
+            } else {
+                if (_has_cursor) {
+                    result.cursor_dx += event->x - _cursor_x;
+                    result.cursor_dy += event->y - _cursor_y;
+                }
+                _has_cursor = true;
+                _cursor_x = event->x;
+                _cursor_y = event->y;
+            }
+            _events.pop();
+        }
+        for (int key = 0; key <= GLFW_KEY_LAST; ++key) {
+            if (_down[key]) {
+                result.held[key] += float(tick_end - std::max(_down_since[key], tick_start));
+            }
+        }
+        return result;
+    }
+};
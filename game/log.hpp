@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Asynchronous logging.
+//
+// Producers format into a slot of a bounded lock-free multi-producer queue
+// and return; a background thread writes batches to stdout/stderr and flushes
+// once per batch. Messages below GOCHI_LOG_LEVEL are compiled out. Frequent
+// events go through Log::Counter and are reported once per second as a total.
+
+#define GOCHI_LOG_DEBUG 0
+#define GOCHI_LOG_INFO 1
+#define GOCHI_LOG_WARN 2
+#define GOCHI_LOG_ERROR 3
+
+#ifndef GOCHI_LOG_LEVEL
+#define GOCHI_LOG_LEVEL GOCHI_LOG_INFO
+#endif
+
+#define GOCHI_LOG(level, ...) \
+    do { if constexpr ((level) >= GOCHI_LOG_LEVEL) Log::Logger::instance().write((level), __VA_ARGS__); } while (0)
+
+#define LOG_DEBUG(...) GOCHI_LOG(GOCHI_LOG_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) GOCHI_LOG(GOCHI_LOG_INFO, __VA_ARGS__)
+#define LOG_WARN(...) GOCHI_LOG(GOCHI_LOG_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) GOCHI_LOG(GOCHI_LOG_ERROR, __VA_ARGS__)
+
+namespace Log {
+
+struct Message {
+    int level;
+    double time;
+    char text[496];  // longer messages are cut and end in "..."
+};
+
+
+// Bounded multi-producer queue (Vyukov): every slot carries a sequence number
+// that tells producers and the consumer whose turn it is, so no locks are taken.
+template <size_t CAPACITY>
+class MpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Message message;
+    };
+
+    Slot _slots[CAPACITY];
+    alignas(64) std::atomic<size_t> _head{0};  // next slot to write
+    alignas(64) size_t _tail = 0;              // next slot to read, consumer only
+public:
+    MpscQueue() {
+        for (size_t i = 0; i < CAPACITY; ++i) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Reserves a slot, lets fill() write the message and publishes it.
+    // Returns false when the queue is full.
+    template <typename Fill>
+    bool push(Fill fill) {
+        size_t position = _head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = _slots[position & (CAPACITY - 1)];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(sequence) - intptr_t(position);
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    fill(slot.message);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(Message& message) {
+        Slot& slot = _slots[_tail & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != _tail + 1) {
+            return false;
+        }
+        message = slot.message;
+        slot.sequence.store(_tail + CAPACITY, std::memory_order_release);
+        ++_tail;
+        return true;
+    }
+};
+
+
+// Event count reported as "N <name> in the last second" instead of a line per event.
+class Counter {
+    const char* _name;
+    std::atomic<uint64_t> _count{0};
+public:
+    explicit Counter(const char* name);
+    ~Counter();
+
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    void add(uint64_t n=1) {
+        _count.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t take() {
+        return _count.exchange(0, std::memory_order_relaxed);
+    }
+
+    const char* name() const {
+        return _name;
+    }
+};
+
+
+class Logger {
+    using clock = std::chrono::steady_clock;
+
+    MpscQueue<4096> _queue;
+    std::atomic<uint64_t> _dropped{0};
+    std::atomic<bool> _running{true};
+    clock::time_point _start = clock::now();
+
+    std::mutex _counters_mutex;  // registration only, never on the hot path
+    std::vector<Counter*> _counters;
+
+    std::thread _writer;
+
+    double now() const {
+        return std::chrono::duration<double>(clock::now() - _start).count();
+    }
+
+    static const char* level_name(int level) {
+        switch (level) {
+            case GOCHI_LOG_DEBUG: return "DEBUG";
+            case GOCHI_LOG_INFO: return "INFO ";
+            case GOCHI_LOG_WARN: return "WARN ";
+            default: return "ERROR";
+        }
+    }
+
+    void report_counters() {
+        std::lock_guard<std::mutex> lock(_counters_mutex);
+        for (auto counter : _counters) {
+            uint64_t count = counter->take();
+            if (count > 0) {
+                write(GOCHI_LOG_INFO, "%llu %s in the last second", (unsigned long long)count, counter->name());
+            }
+        }
+        uint64_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            write(GOCHI_LOG_WARN, "log queue full, %llu messages dropped", (unsigned long long)dropped);
+        }
+    }
+
+    // returns whether anything was written
+    bool drain() {
+        Message message;
+        bool wrote_out = false;
+        bool wrote_err = false;
+        while (_queue.pop(message)) {
+            FILE* stream = message.level >= GOCHI_LOG_WARN ? stderr : stdout;
+            fprintf(stream, "[%9.3f] %s %s\n", message.time, level_name(message.level), message.text);
+            wrote_out = wrote_out || stream == stdout;
+            wrote_err = wrote_err || stream == stderr;
+        }
+        if (wrote_out) fflush(stdout);
+        if (wrote_err) fflush(stderr);
+        return wrote_out || wrote_err;
+    }
+
+    void run() {
+        double last_report = now();
+        while (_running.load(std::memory_order_acquire)) {
+            bool wrote = drain();
+            if (now() - last_report >= 1.0) {
+                report_counters();
+                last_report = now();
+            }
+            if (!wrote) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        // make room for the final counters before reporting them
+        drain();
+        report_counters();
+        drain();
+    }
+
+    Logger() : _writer(&Logger::run, this) {}
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger() {
+        _running.store(false, std::memory_order_release);
+        _writer.join();
+    }
+
+    void write(int level, const char* format, ...)
+#ifdef __GNUC__
+        __attribute__((format(printf, 3, 4)))
+#endif
+    {
+        va_list args;
+        va_start(args, format);
+        bool pushed = _queue.push([&](Message& message) {
+            message.level = level;
+            message.time = now();
+            int length = vsnprintf(message.text, sizeof(message.text), format, args);
+            if (length >= int(sizeof(message.text))) {
+                memcpy(message.text + sizeof(message.text) - 4, "...", 4);
+            }
+        });
+        va_end(args);
+        if (!pushed) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void add_counter(Counter* counter) {
+        std::lock_guard<std::mutex> lock(_counters_mutex);
+        _counters.push_back(counter);
+    }
+
+    void remove_counter(Counter* counter) {
+        uint64_t count = counter->take();
+        if (count > 0) {
+            write(GOCHI_LOG_INFO, "%llu %s in the last second", (unsigned long long)count, counter->name());
+        }
+        std::lock_guard<std::mutex> lock(_counters_mutex);
+        _counters.erase(std::remove(_counters.begin(), _counters.end(), counter), _counters.end());
+    }
+};
+
+
+inline Counter::Counter(const char* name) : _name(name) {
+    Logger::instance().add_counter(this);
+}
+
+inline Counter::~Counter() {
+    Logger::instance().remove_counter(this);
+}
+
+
+// A line for scripts on stdout: "RESULT <name> key=value ...". Results are not
+// log messages. They are written at once whatever GOCHI_LOG_LEVEL is, and
+// log lines can be reworded without breaking the scripts that read results.
+#ifdef __GNUC__
+__attribute__((format(printf, 1, 2)))
+#endif
+inline void result(const char* format, ...) {
+    char text[sizeof(Message::text)];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    fprintf(stdout, "RESULT %s\n", text);
+    fflush(stdout);
+}
+
+}  // namespace Log
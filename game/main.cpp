@@ -1,12 +1,13 @@
 // Include standard headers
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
-#include <random>
 #include <algorithm>
-#include <iostream>  // for debugging
+#include <string>
+#include <cstring>
 
 // Include GLEW
 #include <GL/glew.h>
@@ -18,17 +19,35 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "camera.hpp"
 #include "controls.hpp"
 #include "objects.hpp"
+#include "render_queue.hpp"
+#include "geometry_cache.hpp"
+#include "scene_graph.hpp"
+#include "world_grid.hpp"
+#include "snapshot.hpp"
+#include "baked_mesh.hpp"
+#include "collision.hpp"
+#include "timing.hpp"
+#include "log.hpp"
+#include "input.hpp"
+#include "headless.hpp"
+#include "parallel.hpp"
+#include "particles.hpp"
+#include "profiler.hpp"
+#include "memory.hpp"
+#include "simulation.hpp"
+#include "batch.hpp"
+#include "bot.hpp"
 #include "common/texture.hpp"
 #include "common/shader.hpp"
 
 
-GLFWwindow* initialize() {
+GLFWwindow* initialize(int width, int height) {
     // Initialise GLFW
     if(!glfwInit()) {
-        fprintf( stderr, "Failed to initialize GLFW\n" );
-        getchar();
+        LOG_ERROR("Failed to initialize GLFW");
         exit(-1);
     }
 
@@ -37,10 +56,9 @@ GLFWwindow* initialize() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
 
     // Open a window and create its OpenGL context
-    GLFWwindow* window = glfwCreateWindow( 1024, 768, "GoChi", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow( width, height, "GoChi", NULL, NULL);
     if(window == NULL) {
-        fprintf( stderr, "Failed to open GLFW window.\n" );
-        getchar();
+        LOG_ERROR("Failed to open GLFW window.");
         glfwTerminate();
         exit(-1);
     }
@@ -48,8 +66,7 @@ GLFWwindow* initialize() {
 
     // Initialize GLEW
     if (glewInit() != GLEW_OK) {
-        fprintf(stderr, "Failed to initialize GLEW\n");
-        getchar();
+        LOG_ERROR("Failed to initialize GLEW");
         glfwTerminate();
         exit(-1);
     }
@@ -60,8 +77,14 @@ GLFWwindow* initialize() {
 //    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // Set the mouse at the center of the screen
-    glfwSetCursorPos(window, 1024/2, 768/2);
+    glfwSetCursorPos(window, width/2, height/2);
 
+    return window;
+}
+
+
+// state shared by the window and the headless context
+void setup_gl() {
     // background
     glClearColor(0.2f, 0.2f, 0.2f, 0.0f);
 
@@ -70,229 +93,512 @@ GLFWwindow* initialize() {
     // Accept fragment if it closer to the camera than the former one
     glDepthFunc(GL_LESS);
 
-    // Cull triangles which normal is not towards the camera
-//    glEnable(GL_CULL_FACE);  todo ENABLE after debug
+    // particles are drawn as points
+    glPointSize(2.0f);
 
-    return window;
+    // Cull triangles which normal is not towards the camera,
+    // meshes are made counter-clockwise seen from outside on load
+    glEnable(GL_CULL_FACE);
 }
 
 
-bool is_too_far(const Object& object) {
-    return glm::distance(Controls::position, object.center) > 10.0f;
+// logs loaded meshes that needed fixing
+void fix_winding(const char* name, Object& object) {
+    Winding::Report report = object.fix_winding();
+    if (report.flipped > 0) {
+        LOG_WARN("%s: flipped %zu of %zu triangles to face outward", name, report.flipped, report.triangles);
+    }
 }
 
-template <typename U, typename V>
-bool are_close(const U& lhs, const V& rhs) {
-    return glm::distance(lhs.center, rhs.center) < lhs.radius + rhs.radius;
-}
 
+void save_scene(const std::string& path, const Simulation& sim, const Floor& floor, const TargetMesh& target_mesh) {
+    Snapshot::Writer writer;
 
-std::default_random_engine generator;
-std::uniform_real_distribution<float> uniform(0.0, 1.0);
-
-void create_target(std::vector<Target>& targets, std::vector<glm::vec3>& speeds, int cur_ts) {
-    float x = uniform(generator) * 2 * 3.14;
-    float h = uniform(generator);
-    glm::vec3 center(5 * sin(x), 0.1 + 3 * h, 5 * cos(x));
-    GLfloat radius = 0.1f + 0.05 * uniform(generator);
-    glm::vec3 angle(
-            uniform(generator) * 3.14,
-            uniform(generator) * 3.14,
-            uniform(generator) * 3.14
-    );
-    std::vector<GLfloat> color({
-           uniform(generator),
-           uniform(generator),
-           uniform(generator)
-    });
-    float brightness = std::accumulate(color.begin(), color.end(), 0.f);
-    targets.emplace_back(center + Controls::position * 0.5f, radius, angle, color,
-            cur_ts + brightness * 1000);
-    speeds.emplace_back(
-            uniform(generator) / 100,
-            uniform(generator) / 100,
-            uniform(generator) / 100
-            );
-}
+    std::vector<GLfloat> floor_vertices = floor.vertex_data();
+    writer.add_mesh(Snapshot::MESH_FLOOR, floor_vertices.data(), floor_vertices.size() / 3,
+        floor.get_colors().data());
 
-template <typename T>
-void remove_object(std::vector<T>& objects, std::vector<glm::vec3>& speeds, int id=0) {
-    if (objects.size() > id) {
-        objects.erase(objects.begin() + id);
-        speeds.erase(speeds.begin() + id);
-    }
-}
-
-
-void create_fireball(std::vector<Fireball>& fireballs, std::vector<glm::vec3>& speeds,
-    const glm::vec3& direction) {
-    auto fireball = Fireball(0.5, 20);
-    fireball.move(Controls::position - glm::vec3(0, 1, 0));
-    fireballs.emplace_back(fireball);
-    speeds.emplace_back(direction * 0.5f);
-}
+    std::vector<GLfloat> cube_vertices = target_mesh.vertex_data();
+    const GLfloat no_color[3] = {0, 0, 0};
+    writer.add_mesh(Snapshot::MESH_CUBE, cube_vertices.data(), cube_vertices.size() / 3, no_color);
 
+    for (const auto& record : sim.records()) {
+        writer.add_entity(record);
+    }
 
-bool fireball_is_available(size_t iteration, size_t last_shoot_time) {
-    return (iteration - last_shoot_time > 20);
+    if (!writer.write(path, uint64_t(sim.time * 1e6))) {
+        LOG_ERROR("Failed to write scene %s", path.c_str());
+    }
 }
 
 
-int main() {
-    GLFWwindow* window = initialize();
-
-    // Create and compile our GLSL program from the shaders
-    GLuint ProgramID = LoadShaders("TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader" );
+// Reads the meshes and the time of a scene. Its targets and fireballs are
+// returned as records, for the world to restore once it exists.
+bool load_scene(const std::string& path, double& time, Floor& floor, std::vector<Triangle>& target_shape,
+    std::vector<Snapshot::EntityRecord>& entities) {
+    Snapshot::MappedFile file(path);
+    Snapshot::View scene(file);
+    if (!scene.valid()) {
+        LOG_ERROR("Failed to load scene %s", path.c_str());
+        return false;
+    }
+    time = scene.timestamp() / 1e6;
 
-    // Get a handle for our "MVP" uniform
-    GLuint MatrixID = glGetUniformLocation(ProgramID, "MVP");
+    if (auto mesh = scene.find_mesh(Snapshot::MESH_FLOOR)) {
+        floor = Floor(scene.mesh_data(*mesh), mesh->vertex_count,
+            std::vector<GLfloat>(mesh->color, mesh->color + 3));
+    }
+    if (auto mesh = scene.find_mesh(Snapshot::MESH_CUBE)) {
+        target_shape = triangles_from_data(scene.mesh_data(*mesh), mesh->vertex_count);
+    }
+    entities.assign(scene.entities().begin(), scene.entities().end());
+    return true;
+}
 
-//     Get a handle for our buffers
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(ProgramID, "vertexPosition_modelspace");
-    GLuint vertexColorID = glGetAttribLocation(ProgramID, "vertexColor");
-    GLuint vertexUVID = glGetAttribLocation(ProgramID, "vertexUV");
 
+struct Options {
+    std::string load_scene;  // snapshot to start from
+    std::string dump_scene;  // where to save the world on exit
+    std::vector<std::string> models;  // baked meshes to place in the scene
+    double fps = 60;        // frame rate cap, 0 to render as fast as possible
+    double tick_rate = 60;  // simulation ticks per second
+    bool overview = false;  // split screen with a top-down view
+    bool headless = false;  // offscreen context instead of a window
+    int width = 1024;
+    int height = 768;
+    size_t frames = 0;  // stop after this many frames and print timing, 0 to run until closed
+    Simulation::Settings world;  // seed, waves and world directory
+    size_t worlds = 0;          // run this many worlds without GL instead of the game
+    size_t batch_ticks = 3600;  // ticks per world of a batch
+    bool memory_report = false;  // flag frames that allocate, report heap use at the end
+    bool autopilot = false;  // scripted input and one tick per frame, so runs replay exactly
+    bool bot = false;  // a bot fires and ramps the targets, frame time is reported against the load
+    Bot::Settings bot_settings;
+    size_t load_bin = 1000;  // entities per bin of the load curve
+};
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    bool fps_set = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--load-scene") && i + 1 < argc) {
+            options.load_scene = argv[++i];
+        } else if (!strcmp(argv[i], "--dump-scene") && i + 1 < argc) {
+            options.dump_scene = argv[++i];
+        } else if (!strcmp(argv[i], "--fps") && i + 1 < argc) {
+            options.fps = atof(argv[++i]);
+            fps_set = true;
+        } else if (!strcmp(argv[i], "--tick-rate") && i + 1 < argc) {
+            options.tick_rate = std::max(atof(argv[++i]), 1.0);
+        } else if (!strcmp(argv[i], "--model") && i + 1 < argc) {
+            options.models.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--world-dir") && i + 1 < argc) {
+            options.world.world_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--overview")) {
+            options.overview = true;
+        } else if (!strcmp(argv[i], "--headless")) {
+            options.headless = true;
+        } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            int width, height;
+            if (sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+                options.width = width;
+                options.height = height;
+            } else {
+                LOG_ERROR("Bad size %s, expected WIDTHxHEIGHT", argv[i]);
+            }
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            options.frames = size_t(atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--wave") && i + 1 < argc) {
+            options.world.wave = size_t(atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--wave-interval") && i + 1 < argc) {
+            options.world.wave_interval = std::max(atof(argv[++i]), 0.0);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            options.world.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--worlds") && i + 1 < argc) {
+            options.worlds = size_t(atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--batch-ticks") && i + 1 < argc) {
+            options.batch_ticks = size_t(atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--memory-report")) {
+            options.memory_report = true;
+        } else if (!strcmp(argv[i], "--autopilot")) {
+            options.autopilot = true;
+        } else if (!strcmp(argv[i], "--bot")) {
+            options.bot = true;
+        } else if (!strcmp(argv[i], "--bot-fire-rate") && i + 1 < argc) {
+            options.bot_settings.fire_rate = std::max(float(atof(argv[++i])), 0.0f);
+        } else if (!strcmp(argv[i], "--bot-targets") && i + 1 < argc) {
+            options.bot_settings.start_targets = size_t(atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--bot-ramp") && i + 1 < argc) {
+            options.bot_settings.ramp = std::max(float(atof(argv[++i])), 0.0f);
+        } else if (!strcmp(argv[i], "--bot-max-targets") && i + 1 < argc) {
+            options.bot_settings.max_targets = size_t(atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--load-bin") && i + 1 < argc) {
+            options.load_bin = size_t(atoll(argv[++i]));
+        } else {
+            LOG_ERROR("Unknown option %s", argv[i]);
+        }
+    }
+    // headless runs measure throughput, so they are not paced unless asked to
+    if (options.headless && !fps_set) {
+        options.fps = 0;
+    }
+    return options;
+}
 
-    std::vector<Target> targets;
-    std::vector<glm::vec3> target_speeds;
-    std::vector<Fireball> fireballs;
-    std::vector<glm::vec3> fireball_speeds;
 
-    Buffer buffer;
+// Runs options.worlds worlds to the end and reports on them, with no window or GL.
+int run_batch(const Options& options) {
     Floor floor;
+    std::vector<Triangle> target_shape;  // not drawn
+    std::vector<Snapshot::EntityRecord> entities;  // a batch takes the floor of a scene, not its objects
+    double time = 0;
+    if (!options.load_scene.empty() && !load_scene(options.load_scene, time, floor, target_shape, entities)) {
+        return -1;
+    }
 
-    GLuint vertexbuffer;
-    glGenBuffers(1, &vertexbuffer);
+    Batch::Settings settings;
+    settings.worlds = options.worlds;
+    settings.ticks = options.batch_ticks;
+    settings.tick_rate = options.tick_rate;
+    settings.world = options.world;
+    WorkerPool pool;
+    Batch::log_report(Batch::run(settings, floor, pool));
+    if (options.memory_report) {
+        Memory::FrameMemory(false).log_report();
+    }
+    return 0;
+}
 
-    GLuint colorbuffer;
-    glGenBuffers(1, &colorbuffer);
 
-    GLuint uvbuffer;
-    glGenBuffers(1, &uvbuffer);
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+    if (options.worlds > 0) {
+        return run_batch(options);
+    }
+    GLFWwindow* window = NULL;
+    HeadlessContext headless;
+    if (options.headless) {
+        if (!headless.create(options.width, options.height)) {
+            return -1;
+        }
+    } else {
+        window = initialize(options.width, options.height);
+    }
+    setup_gl();
+
+    // Create and compile our GLSL programs from the shaders
+    GLuint ColorProgramID, InstancedColorProgramID, InstancedTextureProgramID;
+    {
+        MEMORY_TAG(TAG_SHADER);
+        ColorProgramID = LoadShaders("TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader");
+        InstancedColorProgramID = LoadShaders("InstancedVertexShader.vertexshader", "ColorFragmentShader.fragmentshader");
+        InstancedTextureProgramID = LoadShaders("InstancedVertexShader.vertexshader", "TextureFragmentShader.fragmentshader");
+    }
+    if (!InstanceArray::hardware_instancing()) {
+        LOG_INFO("No ARB_instanced_arrays, drawing targets and fireballs one by one");
+    }
 
     // Load the texture using any two methods
     //GLuint Texture = loadBMP_custom("uvtemplate.bmp");
     GLuint Texture = loadBMP_custom("fireearth.bmp");
 
-    // Get a handle for our "myTextureSampler" uniform
-    GLuint TextureID  = glGetUniformLocation(ProgramID, "myTextureSampler");
+    Material flat_material(ColorProgramID);
+    Material target_material(InstancedColorProgramID);
+    Material fireball_material(InstancedTextureProgramID, Texture);
 
-    size_t iteration = 0;
-    size_t last_shoot_time = 0;
-    do {
-        buffer.clear();
+    Floor floor;  // tile repeated over the world cells
+    std::vector<Triangle> target_shape;  // from a scene, empty for the generated cube
 
-        // create targets
-        if (uniform(generator) < 0.3) {  // 0.03
-            create_target(targets, target_speeds, iteration);
+    // geometry rebuilt every frame (particles)
+    Buffer buffer;
+    Mesh mesh;
+    RenderQueue queue;
+
+    double start_time = 0;
+    std::vector<Snapshot::EntityRecord> entities;
+    if (!options.load_scene.empty()) {
+        load_scene(options.load_scene, start_time, floor, target_shape, entities);
+    }
+
+    std::vector<Model> models;
+    for (const auto& path : options.models) {
+        MEMORY_TAG(TAG_MESH);
+        Snapshot::MappedFile file(path);
+        BakedMesh::View baked(file);
+        if (baked.valid()) {
+            models.emplace_back(baked);
+        } else {
+            LOG_ERROR("Failed to load model %s", path.c_str());
         }
+    }
+
+    fix_winding("floor", floor);
 
-        // remove objects that are too far
-        for (size_t i = 0; i < targets.size(); ++i) {
-            if (targets[i].expired(iteration)) {
-                remove_object(targets, target_speeds, i);
+    // floor tiles never move, they are written once and uploaded when cells stream in
+    GeometryCache static_geometry(GL_STATIC_DRAW);
+    // the one mesh every target and fireball is an instance of, unit sized and black;
+    // generated meshes are wound outward at compile time, loaded ones are checked
+    TargetMesh target_mesh = target_shape.empty() ? TargetMesh() : TargetMesh(target_shape);
+    FireballMesh fireball_mesh;
+    if (!target_shape.empty()) {
+        fix_winding("target", target_mesh);
+    }
+    static_geometry.update(target_mesh);
+    static_geometry.update(fireball_mesh);
+    static_geometry.upload();
+
+    WorkerPool workers;
+    Simulation sim(options.world, floor, static_geometry, workers, start_time);
+    sim.restore(entities);
+    Bot bot(options.bot_settings, start_time);
+    LoadCurve load_curve(options.load_bin);
+    size_t entity_count = 0;  // live targets and fireballs at the end of the last frame's ticks
+
+    // The player holds the next fireball at the muzzle. It hangs off the player's
+    // node, so it follows the player's moves and turns, and spins in the shader.
+    SceneGraph scene;
+    const SceneGraph::NodeId player_node = scene.create();
+    const SceneGraph::NodeId launcher_node = scene.create(player_node);
+    scene.set_local(launcher_node, glm::translate(glm::mat4(1.0f), MUZZLE_OFFSET));
+    const float LAUNCHER_SPIN = 3.0f;  // radians per second
+    InstanceArray launcher_instances;
+    launcher_instances.add(Instance{{0, 0, 0, 0}, {0, 0, 0, FIREBALL_RADIUS}, {0, 0, 0}, {0, LAUNCHER_SPIN, 0}, {0, 0, 0}});
+
+    Camera camera;
+    Camera overview(45.0f, 4.0f / 3.0f, 0.1f, 200.0f);
+
+    Clock clock;
+    Input input(clock);
+    FrameProfiler profiler(clock);
+    Memory::FrameMemory memory(options.memory_report);
+    if (!profiler.gpu_timing()) {
+        LOG_INFO("No ARB_timer_query, timing the CPU side only");
+    }
+    const size_t TICK_ZONE = profiler.add_zone("tick", false);
+    const size_t UPLOAD_ZONE = profiler.add_zone("upload");
+    const size_t DRAW_ZONE = profiler.add_zone("draw");
+    if (window) {
+        input.attach(window);
+    }
+    FramePacer pacer(options.fps);
+    // never below a third of the requested rate, at most 4 ticks per frame
+    Timestep timestep(options.tick_rate, options.tick_rate / 3, 4);
+    TimingStats timing;
+    FrameTimes frame_times;  // only for runs with a frame limit, which print a summary
+    frame_times.reserve(options.frames);
+    size_t frame = 0;
+    Log::Counter collision_counter("collisions");
+    Log::Counter fire_counter("fireballs fired");
+    double last_frame = clock.now();
+    double last_report = last_frame;
+    double input_time = last_frame;  // end of the input already handed to ticks
+    do {
+        double frame_start = clock.now();
+        double frame_time = frame_start - last_frame;
+        profiler.begin_frame();
+        memory.begin_frame();
+        last_frame = frame_start;
+        timing.frames += 1;
+        timing.frame_time += frame_time;
+        timing.max_frame_time = std::max(timing.max_frame_time, frame_time);
+        if (frame++ > 0) {
+            if (options.frames > 0) {
+                frame_times.add(frame_time);
+            }
+            if (options.bot) {
+                load_curve.add(entity_count, frame_time);
             }
         }
 
         bool has_collision = false;
-        // remove collided objects
-        for (size_t i = 0; i < targets.size(); ++i) {
-            for (size_t j = 0; j < fireballs.size(); ++j) {
-                if (are_close(targets[i], fireballs[j])) {
-                    std::cout << "COLLIDE" << std::endl;
-                    remove_object(targets, target_speeds, i);
-                    remove_object(fireballs, fireball_speeds, j);
-                    has_collision = true;
-                    break;
-                }
+        // scripted runs take one tick per frame, so the load follows the frame count
+        bool scripted = options.autopilot || options.bot;
+        size_t ticks = timestep.advance(scripted ? timestep.tick() : frame_time, timing);
+        profiler.begin(TICK_ZONE);
+        for (size_t tick = 0; tick < ticks; ++tick) {
+            const float dt = float(timestep.tick());
+
+            // ticks of this frame split the input since the previous frame evenly
+            double tick_start = input_time + tick * (frame_start - input_time) / ticks;
+            double tick_end = input_time + (tick + 1) * (frame_start - input_time) / ticks;
+            TickInput tick_input = options.autopilot ? Batch::autopilot(dt)
+                : options.bot ? TickInput() : input.consume(tick_start, tick_end);
+            if (options.bot) {
+                fire_counter.add(bot.drive(sim, dt));
             }
+            Simulation::Events events = sim.tick(dt, tick_input);
+            has_collision = has_collision || events.collisions > 0;
+            collision_counter.add(events.collisions);
+            fire_counter.add(events.fired);
+        }
+        if (ticks > 0) {
+            input_time = frame_start;
         }
+
+        sim.stream();
+        profiler.end(TICK_ZONE);
+        entity_count = sim.targets.size() + sim.fireballs.size();
+
         if (has_collision) {
             glClearColor(1.0f, 1.0f, 0.2f, 0.0f);
         } else {
             glClearColor(0.2f, 0.2f, 0.2f, 0.0f);
         }
 
-
-        if (Controls::isSpacePressed(window) && fireball_is_available(iteration, last_shoot_time)) {
-            last_shoot_time = iteration;
-            std::cout << "Fire!\n";
-            create_fireball(fireballs, fireball_speeds, Controls::direction);
+        // Cameras only rebuild their matrices when the player moved or the window was resized
+        int width = headless.width();
+        int height = headless.height();
+        if (window) {
+            glfwGetFramebufferSize(window, &width, &height);
         }
-
-        floor.draw(buffer);
-        for (size_t i = 0; i < targets.size(); ++i) {
-            targets[i].move(target_speeds[i]);
-            targets[i].draw(buffer);
+        int view_width = options.overview ? width / 2 : width;
+        float aspect = float(view_width) / std::max(height, 1);
+        camera.set_aspect(aspect);
+        sim.controls.updateCamera(camera);
+        overview.set_aspect(aspect);
+        overview.look(sim.controls.position + glm::vec3(0, 20, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1));
+        float yaw = std::atan2(sim.controls.direction.x, sim.controls.direction.z);
+        scene.set_local(player_node,
+            glm::rotate(glm::translate(glm::mat4(1.0f), sim.controls.position), yaw, glm::vec3(0, 1, 0)));
+        scene.update();
+
+        // objects outside of every view are not sent to the GPU
+        size_t culled = 0;
+        auto visible = [&](const glm::vec3& center, float radius) {
+            bool result = camera.sphere_visible(center, radius)
+                || (options.overview && overview.sphere_visible(center, radius));
+            culled += !result;
+            return result;
+        };
+
+        for (const auto& cell : sim.world.active_cells()) {
+            const Floor& tile = sim.world.tile(cell);
+            if (visible(tile.center, sim.world.cell_radius())) {
+                queue.submit(flat_material, static_geometry.mesh(), tile.slot);
+            }
         }
-
-        for (size_t i = 0; i < fireballs.size(); ++i) {
-            fireballs[i].move(fireball_speeds[i]);
-            fireballs[i].draw(buffer);
+        for (const auto& model : models) {
+            if (visible(model.center, model.radius)) {
+                queue.submit(flat_material, model.mesh, model.range);
+            }
         }
+        // one instanced draw each, clipped on the GPU rather than culled here
+        queue.submit_instanced(target_material, static_geometry.mesh(), target_mesh.slot, sim.target_instances);
+        queue.submit_instanced(fireball_material, static_geometry.mesh(), fireball_mesh.slot, sim.fireball_instances);
+        queue.submit_instanced(fireball_material, static_geometry.mesh(), fireball_mesh.slot, launcher_instances,
+            &scene.world(launcher_node));
+        buffer.clear();
+        queue.submit(flat_material, mesh, sim.particles.draw(buffer, workers), GL_POINTS);
 
         // Clear the screen
+        glViewport(0, 0, width, height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Get position from controls
-        Controls::computeMatricesFromInputs(window);
-        glm::mat4 ProjectionMatrix = Controls::getProjectionMatrix();
-        glm::mat4 ViewMatrix = Controls::getViewMatrix();
-        glm::mat4 ModelMatrix = glm::mat4(1.0);
-        glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-        glUseProgram(ProgramID);
-        // Send our transformation to the currently bound shader,
-        // in the "MVP" uniform
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, Texture);
-        glUniform1i(TextureID, 0);
-
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(vertexPosition_modelspaceID);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * buffer.size(), buffer.vertex_data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(vertexPosition_modelspaceID, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-        // 2nd attribute buffer : colors
-        glEnableVertexAttribArray(vertexColorID);
-        glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * buffer.size(), buffer.color_data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(vertexColorID, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-        // 3rd attribute buffer : textures
-        glEnableVertexAttribArray(vertexUVID);
-        glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * buffer.texture_size(), buffer.texture_data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(vertexUVID, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-        glDrawArrays(GL_TRIANGLES, 0, buffer.size() / 3);
-
-        glDisableVertexAttribArray(vertexPosition_modelspaceID);
-        glDisableVertexAttribArray(vertexColorID);
-        glDisableVertexAttribArray(vertexUVID);
+        profiler.begin(UPLOAD_ZONE);
+        static_geometry.upload();
+        sim.target_instances.upload();
+        sim.fireball_instances.upload();
+        launcher_instances.upload();
+        mesh.upload(buffer);
+        profiler.end(UPLOAD_ZONE);
+
+        // Vertices are in world space or placed by the shader, so the MVP is the cached view-projection,
+        // times the world matrix for items placed by the scene graph
+        profiler.begin(DRAW_ZONE);
+        glViewport(0, 0, view_width, height);
+        queue.render(camera.view_projection(), float(sim.time));
+        if (options.overview) {
+            glViewport(view_width, 0, width - view_width, height);
+            queue.render(overview.view_projection(), float(sim.time));
+        }
+        profiler.end(DRAW_ZONE);
+        queue.clear();
+
+        if (frame_start - last_report > 5.0) {
+            const RenderStats& stats = queue.stats();
+            LOG_INFO("fps: %.1f, frame: %.2f ms avg / %.2f ms max, sleep: %.0f%%, ticks: %zu (%zu dropped) at %.0f Hz",
+                timing.frames / (frame_start - last_report),
+                timing.average_frame_ms(), 1000 * timing.max_frame_time,
+                100 * timing.sleep_time / (frame_start - last_report),
+                timing.ticks, timing.dropped_ticks, timing.tick_rate);
+            LOG_INFO("draw calls: %zu, state changes: %zu, culled: %zu, particles: %zu (%zu dropped), "
+                   "uploaded: %zu of %zu instances, world: %zu of %zu cells active, %zu targets stored",
+                stats.draw_calls, stats.state_changes, culled,
+                sim.particles.size(), sim.particles.take_dropped(),
+                sim.target_instances.uploaded() + sim.fireball_instances.uploaded(),
+                sim.targets.size() + sim.fireballs.size(),
+                sim.world.active_cells().size(), sim.world.cell_count(), sim.world.stored_count());
+            profiler.log_report();
+            timing = TimingStats();
+            last_report = frame_start;
+        }
+
+        // keep sampling input while waiting, so event timestamps stay accurate
+        timing.sleep_time += pacer.wait(clock, [window] {
+            if (window) {
+                glfwPollEvents();
+            }
+        });
+
         // Swap buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-        ++iteration;
-        // todo count time not iterations
-
-    } // Check if the ESC key was pressed or the window was closed
-    while(glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS
-          && glfwWindowShouldClose(window) == 0);
-
-    // Cleanup VBO and shader
-    glDeleteBuffers(1, &vertexbuffer);
-    glDeleteBuffers(1, &colorbuffer);
-    glDeleteBuffers(1, &uvbuffer);
+        if (window) {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        } else {
+            headless.finish_frame();
+        }
+        memory.end_frame();
+
+    } // Check if the frame limit was reached, the ESC key was pressed or the window was closed
+    while((options.frames == 0 || frame < options.frames)
+          && (!window || (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS
+                          && glfwWindowShouldClose(window) == 0)));
+
+    if (frame_times.size() > 0 && options.frames > 0) {
+        LOG_INFO("%zu frames at %dx%d in %.3f s: %.1f fps, frame ms: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f",
+            frame_times.size(), options.width, options.height, frame_times.total(),
+            frame_times.size() / frame_times.total(),
+            1000 * frame_times.percentile(0.5), 1000 * frame_times.percentile(0.95),
+            1000 * frame_times.percentile(0.99), 1000 * frame_times.percentile(1.0));
+        Log::result("render frames=%zu width=%d height=%d seconds=%.3f fps=%.2f p50_ms=%.3f p95_ms=%.3f "
+            "p99_ms=%.3f max_ms=%.3f", frame_times.size(), options.width, options.height, frame_times.total(),
+            frame_times.size() / frame_times.total(),
+            1000 * frame_times.percentile(0.5), 1000 * frame_times.percentile(0.95),
+            1000 * frame_times.percentile(0.99), 1000 * frame_times.percentile(1.0));
+        profiler.log_report();
+    }
+    if (options.bot) {
+        load_curve.log_report(options.fps > 0 ? 1 / options.fps : 1.0 / 60);
+    }
+    if (options.memory_report) {
+        memory.log_report();
+    }
+
+    if (!options.dump_scene.empty()) {
+        save_scene(options.dump_scene, sim, floor, target_mesh);
+    }
+
+    // Cleanup VBO and shaders
+    mesh.release();
+    sim.target_instances.release();
+    sim.fireball_instances.release();
+    launcher_instances.release();
+    static_geometry.release();
+    for (auto& model : models) {
+        model.release();
+    }
+    profiler.release();
     glDeleteTextures(1, &Texture);
-    glDeleteProgram(ProgramID);
+    glDeleteProgram(ColorProgramID);
+    glDeleteProgram(InstancedColorProgramID);
+    glDeleteProgram(InstancedTextureProgramID);
 //    glDeleteVertexArrays(1, &VertexArrayID);
 
     // Close OpenGL window and terminate GLFW
-    glfwTerminate();
+    if (window) {
+        glfwTerminate();
+    } else {
+        headless.release();
+    }
     return 0;
 }
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "log.hpp"
+
+// Heap telemetry, a guardrail for allocation-free gameplay.
+//
+// Built with GOCHI_MEMORY_TELEMETRY, memory_hooks.cpp replaces the global
+// operator new and delete: every allocation is counted, with its bytes, under
+// the tag of the innermost MEMORY_TAG scope of its thread. FrameMemory turns
+// the totals into per-frame counts and, in report mode, flags the frames that
+// allocate once the game should have reached a steady state. Without the flag
+// the tags compile to nothing and only the peak RSS is reported.
+namespace Memory {
+
+enum Tag : uint8_t {
+    TAG_OTHER,
+    TAG_MESH,    // triangles and geometry of objects
+    TAG_BUFFER,  // CPU copies of vertex and instance data
+    TAG_ENTITY,  // targets and fireballs
+    TAG_SHADER,  // shader sources and programs
+    TAG_COUNT
+};
+
+inline const char* tag_name(size_t tag) {
+    static const char* const names[TAG_COUNT] = {"other", "mesh", "buffer", "entity", "shader"};
+    return tag < TAG_COUNT ? names[tag] : "?";
+}
+
+#ifdef GOCHI_MEMORY_TELEMETRY
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+
+struct Counts {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;  // allocated
+
+    Counts operator-(const Counts& other) const {
+        return Counts{allocations - other.allocations, frees - other.frees, bytes - other.bytes};
+    }
+};
+
+
+// process wide totals, updated by the hooks
+struct TagCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<int64_t> live_bytes{0};
+};
+
+inline TagCounters counters[TAG_COUNT];
+inline thread_local Tag current_tag = TAG_OTHER;
+
+inline void count_allocation(Tag tag, size_t size) {
+    counters[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+    counters[tag].bytes.fetch_add(size, std::memory_order_relaxed);
+    counters[tag].live_bytes.fetch_add(int64_t(size), std::memory_order_relaxed);
+}
+
+inline void count_free(Tag tag, size_t size) {
+    counters[tag].frees.fetch_add(1, std::memory_order_relaxed);
+    counters[tag].live_bytes.fetch_sub(int64_t(size), std::memory_order_relaxed);
+}
+
+inline Counts totals(size_t tag) {
+    return Counts{
+        counters[tag].allocations.load(std::memory_order_relaxed),
+        counters[tag].frees.load(std::memory_order_relaxed),
+        counters[tag].bytes.load(std::memory_order_relaxed)
+    };
+}
+
+inline int64_t live_bytes(size_t tag) {
+    return counters[tag].live_bytes.load(std::memory_order_relaxed);
+}
+
+
+// Allocations of this thread go to tag until the scope ends.
+class TagScope {
+    Tag _previous;
+public:
+    explicit TagScope(Tag tag) : _previous(current_tag) {
+        current_tag = tag;
+    }
+
+    ~TagScope() {
+        current_tag = _previous;
+    }
+
+    TagScope(const TagScope&) = delete;
+    TagScope& operator=(const TagScope&) = delete;
+};
+
+#ifdef GOCHI_MEMORY_TELEMETRY
+#define MEMORY_TAG(tag) Memory::TagScope memory_tag_scope(Memory::tag)
+#else
+#define MEMORY_TAG(tag) do {} while (0)
+#endif
+
+
+// Highest resident set size of the process so far, 0 where unknown.
+inline size_t peak_rss() {
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);  // bytes
+#else
+    return size_t(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+#endif
+}
+
+
+// Allocations per frame, on the frame loop's thread and every worker.
+//
+// After warmup frames the game is expected to run without allocating; in
+// report mode each frame that does is logged with its counts by tag, up to
+// MAX_FLAGGED lines, and counted for the summary.
+class FrameMemory {
+public:
+    static constexpr size_t MAX_FLAGGED = 20;
+
+private:
+    bool _report;
+    size_t _warmup;
+    size_t _frame = 0;
+    Counts _start[TAG_COUNT];
+    // over the run, steady state frames only
+    size_t _steady_frames = 0;
+    size_t _allocating_frames = 0;
+    uint64_t _allocations = 0;
+    uint64_t _bytes = 0;
+    uint64_t _max_allocations = 0;
+    Counts _by_tag[TAG_COUNT];
+
+public:
+    explicit FrameMemory(bool report, size_t warmup=120) : _report(report), _warmup(warmup) {}
+
+    void begin_frame() {
+        for (size_t tag = 0; tag < TAG_COUNT; ++tag) {
+            _start[tag] = totals(tag);
+        }
+    }
+
+    void end_frame() {
+        ++_frame;
+        if (!ENABLED || _frame <= _warmup) {
+            return;
+        }
+        Counts frame[TAG_COUNT];
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        for (size_t tag = 0; tag < TAG_COUNT; ++tag) {
+            frame[tag] = totals(tag) - _start[tag];
+            allocations += frame[tag].allocations;
+            bytes += frame[tag].bytes;
+            _by_tag[tag].allocations += frame[tag].allocations;
+            _by_tag[tag].frees += frame[tag].frees;
+            _by_tag[tag].bytes += frame[tag].bytes;
+        }
+        ++_steady_frames;
+        _allocations += allocations;
+        _bytes += bytes;
+        _max_allocations = std::max(_max_allocations, allocations);
+        if (allocations == 0) {
+            return;
+        }
+        ++_allocating_frames;
+        if (_report && _allocating_frames <= MAX_FLAGGED) {
+            std::string tags;
+            for (size_t tag = 0; tag < TAG_COUNT; ++tag) {
+                if (frame[tag].allocations > 0) {
+                    char text[64];
+                    snprintf(text, sizeof(text), " %s %llu/%llu B", tag_name(tag),
+                        (unsigned long long)frame[tag].allocations, (unsigned long long)frame[tag].bytes);
+                    tags += text;
+                }
+            }
+            LOG_WARN("frame %zu allocated %llu times, %llu bytes:%s",
+                _frame, (unsigned long long)allocations, (unsigned long long)bytes, tags.c_str());
+        }
+    }
+
+    size_t allocating_frames() const {
+        return _allocating_frames;
+    }
+
+    void log_report() const {
+        if (!ENABLED) {
+            LOG_INFO("memory: peak rss %.1f MB, allocations not counted (built without GOCHI_MEMORY_TELEMETRY)",
+                peak_rss() / 1048576.0);
+            return;
+        }
+        LOG_INFO("memory: peak rss %.1f MB, %zu of %zu steady frames allocated, "
+            "%.1f allocations / %.0f bytes per frame, %llu at most",
+            peak_rss() / 1048576.0, _allocating_frames, _steady_frames,
+            _steady_frames ? double(_allocations) / _steady_frames : 0.0,
+            _steady_frames ? double(_bytes) / _steady_frames : 0.0,
+            (unsigned long long)_max_allocations);
+        for (size_t tag = 0; tag < TAG_COUNT; ++tag) {
+            Counts total = totals(tag);
+            LOG_INFO("memory %s: %llu allocations, %llu in steady frames, %.1f MB live",
+                tag_name(tag), (unsigned long long)total.allocations,
+                (unsigned long long)_by_tag[tag].allocations, live_bytes(tag) / 1048576.0);
+        }
+    }
+};
+
+}  // namespace Memory
@@ -0,0 +1,94 @@
+// Global operator new and delete counting into Memory::counters.
+// Compiled in only with GOCHI_MEMORY_TELEMETRY, see memory.hpp.
+
+#include <cstdlib>
+#include <new>
+
+#include "memory.hpp"
+
+namespace {
+
+// Every block starts with a header holding its size and tag, so a free is
+// charged to the tag that allocated it. Its size keeps the block aligned for
+// any fundamental type; over-aligned types use the aligned forms, which are
+// left to the library and not counted.
+struct alignas(alignof(std::max_align_t)) Header {
+    size_t size;
+    Memory::Tag tag;
+};
+
+void* allocate(size_t size) noexcept {
+    Header* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+    if (!header) {
+        return nullptr;
+    }
+    header->size = size;
+    header->tag = Memory::current_tag;
+    Memory::count_allocation(header->tag, size);
+    return header + 1;
+}
+
+void release(void* pointer) noexcept {
+    if (!pointer) {
+        return;
+    }
+    Header* header = static_cast<Header*>(pointer) - 1;
+    Memory::count_free(header->tag, header->size);
+    std::free(header);
+}
+
+void* allocate_or_throw(size_t size) {
+    for (;;) {
+        if (void* pointer = allocate(size)) {
+            return pointer;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+}  // namespace
+
+
+void* operator new(size_t size) {
+    return allocate_or_throw(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate_or_throw(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    release(pointer);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <vector>
 #include <cassert>
 #include <stdexcept>
@@ -10,22 +11,29 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "collision.hpp"
+#include "winding.hpp"
+#include "memory.hpp"
+#include "../common/primitives.hpp"
+
 class Triangle {
-    std::vector<glm::vec3> points;
+    std::array<glm::vec3, 3> points;
 
 public:
-    Triangle(const std::vector<GLfloat>& data) {
-        assert(data.size() == 9);
+    // from 9 floats, xyz of each corner
+    explicit Triangle(const GLfloat* data) {
         for (size_t i = 0; i < 3; ++i) {
-            auto iter = data.begin() + 3 * i;
-            points.emplace_back(
-                    glm::vec3(*iter, *(iter+1), *(iter+2))
-            );
+            points[i] = glm::vec3(data[3 * i], data[3 * i + 1], data[3 * i + 2]);
         }
     }
 
-    Triangle(const std::vector<glm::vec3>& points) : points(points) {
+    Triangle(const std::vector<GLfloat>& data) : Triangle(data.data()) {
+        assert(data.size() == 9);
+    }
+
+    Triangle(const std::vector<glm::vec3>& points) {
         assert(points.size() == 3);
+        std::copy(points.begin(), points.end(), this->points.begin());
     }
 
     void move(const glm::vec3& shift) {
@@ -40,7 +48,8 @@ public:
         }
     }
 
-    void turn(const glm::vec3& angle) {
+    // rotation in the xy, xz and again xy planes by angle.x, angle.y and angle.z
+    static glm::vec3 rotate(const glm::vec3& point, const glm::vec3& angle) {
         GLfloat sin1 = sin(angle.x);
         GLfloat cos1 = cos(angle.x);
         GLfloat sin2 = sin(angle.y);
@@ -48,29 +57,46 @@ public:
         GLfloat sin3 = sin(angle.z);
         GLfloat cos3 = cos(angle.z);
 
+        glm::vec3 result = point;
+        glm::vec3 new_point;
+        new_point.x = result.x * cos1 - result.y * sin1;
+        new_point.y = result.x * sin1 + result.y * cos1;
+        new_point.z = result.z;
+        result = new_point;
+        new_point.x = result.x * cos2 - result.z * sin2;
+        new_point.z = result.x * sin2 + result.z * cos2;
+        new_point.y = result.y;
+        result = new_point;
+        new_point.x = result.x * cos3 - result.y * sin3;
+        new_point.y = result.x * sin3 + result.y * cos3;
+        new_point.z = result.z;
+        return new_point;
+    }
+
+    void turn(const glm::vec3& angle) {
         for (auto& point : points) {
-            glm::vec3 new_point;
-            new_point.x = point.x * cos1 - point.y * sin1;
-            new_point.y = point.x * sin1 + point.y * cos1;
-            new_point.z = point.z;
-            point = new_point;
-            new_point.x = point.x * cos2 - point.z * sin2;
-            new_point.z = point.x * sin2 + point.z * cos2;
-            new_point.y = point.y;
-            point = new_point;
-            new_point.x = point.x * cos3 - point.y * sin3;
-            new_point.y = point.x * sin3 + point.y * cos3;
-            new_point.z = point.z;
-            point = new_point;
+            point = rotate(point, angle);
         }
     }
 
-    const std::vector<glm::vec3>& get_points() const {
+    // reverses the winding
+    void flip() {
+        std::swap(points[1], points[2]);
+    }
+
+    const std::array<glm::vec3, 3>& get_points() const {
         return points;
     }
 };
 
 
+// Vertex range an object occupies inside a Buffer.
+struct BufferRange {
+    GLint first;
+    GLsizei count;
+};
+
+
 class Buffer {
     std::vector<GLfloat> _vertex_data;
     std::vector<GLfloat> _color_data;
@@ -81,6 +107,7 @@ public:
     void clear() {
         _vertex_data.clear();
         _color_data.clear();
+        _texture_data.clear();
     }
 
     const void* vertex_data() {
@@ -104,32 +131,76 @@ public:
         return _texture_data.size();
     }
 
-    void add(const std::vector<Triangle>& triangles, const std::vector<GLfloat>& colors,
+    size_t vertex_count() const {
+        return _vertex_data.size() / 3;
+    }
+
+    // room for count more vertices at the end, filled in by write()
+    BufferRange allocate(size_t count) {
+        MEMORY_TAG(TAG_BUFFER);
+        BufferRange range{GLint(vertex_count()), GLsizei(count)};
+        _vertex_data.resize(_vertex_data.size() + 3 * count);
+        _color_data.resize(_color_data.size() + 3 * count);
+        _texture_data.resize(_texture_data.size() + 2 * count);
+        return range;
+    }
+
+    // overwrites range, which must hold exactly the vertices of triangles
+    void write(const BufferRange& range, const std::vector<Triangle>& triangles, const std::vector<GLfloat>& colors,
         const std::vector<glm::vec2>& texcoords) {
         assert(colors.size() == 3);
+        assert(size_t(range.count) == 3 * triangles.size());
 
+        GLfloat* vertex = _vertex_data.data() + 3 * range.first;
+        GLfloat* color = _color_data.data() + 3 * range.first;
         for (auto& triangle: triangles) {
             for (const auto& point : triangle.get_points()) {
-                _vertex_data.emplace_back(point.x);
-                _vertex_data.emplace_back(point.y);
-                _vertex_data.emplace_back(point.z);
-            }
-
-            for (int i = 0; i < 3; ++i) {
+                *vertex++ = point.x;
+                *vertex++ = point.y;
+                *vertex++ = point.z;
                 for (auto comp : colors) {
-                    _color_data.emplace_back(comp);
+                    *color++ = comp;
                 }
             }
         }
 
-        for (auto& coords: texcoords) {
-            _texture_data.emplace_back(coords.x);
-            _texture_data.emplace_back(coords.y);
+        // untextured objects still get uv slots, so all attributes share vertex indices
+        GLfloat* uv = _texture_data.data() + 2 * range.first;
+        for (size_t i = 0; i < size_t(range.count); ++i) {
+            glm::vec2 coords = i < texcoords.size() ? texcoords[i] : glm::vec2(0, 0);
+            *uv++ = coords.x;
+            *uv++ = coords.y;
         }
     }
+
+    BufferRange add(const std::vector<Triangle>& triangles, const std::vector<GLfloat>& colors,
+        const std::vector<glm::vec2>& texcoords) {
+        BufferRange range = allocate(3 * triangles.size());
+        write(range, triangles, colors, texcoords);
+        return range;
+    }
+
+    // Appends count points, fill(positions, colors) writes their xyz and rgb in place.
+    template <typename Fill>
+    BufferRange add_points(size_t count, Fill fill) {
+        BufferRange range = allocate(count);
+        fill(_vertex_data.data() + 3 * range.first, _color_data.data() + 3 * range.first);
+        return range;
+    }
 };
 
 
+inline std::vector<Triangle> triangles_from_data(const GLfloat* vertices, size_t vertex_count) {
+    MEMORY_TAG(TAG_MESH);
+    std::vector<Triangle> result;
+    result.reserve(vertex_count / 3);
+    for (size_t i = 0; i + 2 < vertex_count; i += 3) {
+        result.emplace_back(vertices + 3 * i);
+    }
+    return result;
+}
+
+
 class Object {
 protected:
     std::vector<Triangle> triangles;
@@ -139,16 +210,77 @@ protected:
     Object() : center(0, 0, 0) {}
 public:
     glm::vec3 center;
-    void draw(Buffer& buffer) const {
-        buffer.add(triangles, colors, texcoords);
+    // where a GeometryCache keeps the vertices, and whether they are out of date
+    BufferRange slot{0, 0};
+    bool dirty = true;
+
+    BufferRange draw(Buffer& buffer) const {
+        return buffer.add(triangles, colors, texcoords);
+    }
+
+    void draw(Buffer& buffer, const BufferRange& range) const {
+        buffer.write(range, triangles, colors, texcoords);
+    }
+
+    size_t vertex_count() const {
+        return 3 * triangles.size();
+    }
+
+    const std::vector<Triangle>& get_triangles() const {
+        return triangles;
+    }
+
+    const std::vector<GLfloat>& get_colors() const {
+        return colors;
+    }
+
+    // flat xyz array of all triangle vertices
+    std::vector<GLfloat> vertex_data() const {
+        std::vector<GLfloat> data;
+        data.reserve(9 * triangles.size());
+        for (const auto& triangle : triangles) {
+            for (const auto& point : triangle.get_points()) {
+                data.insert(data.end(), {point.x, point.y, point.z});
+            }
+        }
+        return data;
     }
 
     void move(const glm::vec3& shift) {
+        dirty = true;
         center += shift;
         for (auto& triangle : triangles) {
             triangle.move(shift);
         }
     }
+
+    // Makes the triangles counter-clockwise seen from outside, so back-face
+    // culling keeps the right side. See winding.hpp.
+    Winding::Report fix_winding() {
+        MEMORY_TAG(TAG_MESH);
+        std::vector<glm::vec3> positions;
+        positions.reserve(3 * triangles.size());
+        for (const auto& triangle : triangles) {
+            positions.insert(positions.end(), triangle.get_points().begin(), triangle.get_points().end());
+        }
+        std::vector<uint32_t> indices(positions.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = uint32_t(i);
+        }
+        std::vector<uint8_t> flipped;
+        Winding::Report report = Winding::orient(positions, indices, &flipped);
+        for (size_t t = 0; t < triangles.size(); ++t) {
+            if (!flipped[t]) {
+                continue;
+            }
+            triangles[t].flip();
+            if (texcoords.size() >= 3 * t + 3) {
+                std::swap(texcoords[3 * t + 1], texcoords[3 * t + 2]);
+            }
+        }
+        dirty = dirty || report.flipped > 0;
+        return report;
+    }
 };
 
 class Floor : public Object {
@@ -168,137 +300,78 @@ public:
         triangles = {t1, t2};
         colors = {0.7, 0.5, 0.2};
     }
+
+    Floor(const GLfloat* vertices, size_t vertex_count, const std::vector<GLfloat>& icolors) {
+        triangles = triangles_from_data(vertices, vertex_count);
+        colors = icolors;
+    }
 };
 
 
-class Fireball : public Object {
+// Compile-time tables behind the game's meshes, see common/primitives.hpp.
+inline constexpr auto CUBE_VERTICES = Primitives::CUBE.triangle_positions();
+inline constexpr auto FIREBALL_SPHERE = Primitives::sphere<10, 20>();
+inline constexpr auto FIREBALL_VERTICES = FIREBALL_SPHERE.triangle_positions();
+inline constexpr auto FIREBALL_TEXCOORDS = FIREBALL_SPHERE.triangle_texcoords();
+
+
+
+// Meshes that targets and fireballs are instances of. They stay around the
+// origin, black: the instanced shader scales, turns and moves them and adds
+// the instance color. These are the only copies of the entities' geometry.
+class TargetMesh : public Object {
 public:
-    GLfloat radius;
+    // the cube, spanning [-1, 1], straight from its compile-time table
+    TargetMesh() {
+        triangles = triangles_from_data(CUBE_VERTICES.data(), Primitives::CUBE.index_count);
+        colors = {0, 0, 0};
+    }
 
-    Fireball(GLfloat radius, size_t triangles_count, const std::vector<GLfloat>& colors={0.0, 0.0, 0.0})
-    : radius(radius) {
-        this->colors = colors;
-        const size_t squares_count = triangles_count / 2;
-        for (size_t i = 0; i < squares_count; ++i) {
-            double theta = (double)glm::pi<double>() * i / squares_count;
-            double theta1 = (double)glm::pi<double>() * (i + 1) / squares_count;
-
-            for (size_t j = 0; j < triangles_count; ++j) {
-                double phi = 2.0f * glm::pi<double>() * j / triangles_count + glm::pi<double>();
-                double phi1 = 2.0f * glm::pi<double>() * (j + 1) / triangles_count + glm::pi<double>();
-
-                //Первый треугольник
-                triangles.emplace_back(Triangle(std::vector<glm::vec3>{
-                    glm::vec3(
-                        cos(phi) * sin(theta) * radius,
-                        sin(phi) * sin(theta) * radius,
-                        cos(theta) * radius
-                    ),
-                    glm::vec3(
-                        cos(phi1) * sin(theta1) * radius,
-                        sin(phi1) * sin(theta1) * radius,
-                        cos(theta1) * radius
-                    ),
-                    glm::vec3(
-                        cos(phi1) * sin(theta) * radius,
-                        sin(phi1) * sin(theta) * radius,
-                        cos(theta) * radius
-                    )
-                }));
-
-                texcoords.emplace_back(glm::vec2((float)j / triangles_count, 1.0 - (float)i / squares_count));
-                texcoords.emplace_back(glm::vec2((float)(j + 1) / triangles_count, 1.0 - (float)(i + 1) / squares_count));
-                texcoords.emplace_back(glm::vec2((float)(j + 1) / triangles_count, 1.0 - (float)i / squares_count));
-
-
-                //Второй треугольник
-                triangles.emplace_back(Triangle(std::vector<glm::vec3>{
-                    glm::vec3(
-                        cos(phi) * sin(theta) * radius,
-                        sin(phi) * sin(theta) * radius,
-                        cos(theta) * radius
-                    ),
-                    glm::vec3(
-                        cos(phi) * sin(theta1) * radius,
-                        sin(phi) * sin(theta1) * radius,
-                        cos(theta1) * radius
-                    ),
-                    glm::vec3(
-                        cos(phi1) * sin(theta1) * radius,
-                        sin(phi1) * sin(theta1) * radius,
-                        cos(theta1) * radius
-                    )
-                }));
-
-                texcoords.emplace_back(glm::vec2((float)j / triangles_count, 1.0f - (float)i / squares_count));
-                texcoords.emplace_back(glm::vec2((float)j / triangles_count, 1.0f - (float)(i + 1) / squares_count));
-                texcoords.emplace_back(glm::vec2((float)(j + 1) / triangles_count, 1.0f - (float)(i + 1) / squares_count));
-            }
+    // a shape loaded from a scene
+    explicit TargetMesh(const std::vector<Triangle>& shape) {
+        triangles = shape;
+        colors = {0, 0, 0};
+    }
+};
+
+class FireballMesh : public Object {
+public:
+    // unit sphere
+    FireballMesh() {
+        triangles = triangles_from_data(FIREBALL_VERTICES.data(), FIREBALL_SPHERE.index_count);
+        colors = {0, 0, 0};
+        texcoords.reserve(FIREBALL_SPHERE.index_count);
+        for (size_t i = 0; i < FIREBALL_SPHERE.index_count; ++i) {
+            texcoords.emplace_back(FIREBALL_TEXCOORDS[2 * i], FIREBALL_TEXCOORDS[2 * i + 1]);
         }
     }
 };
 
-const std::vector<Triangle> CUBE_TRIANGLES = {
-        Triangle({-1.0f, -1.0f,-1.0f,
-        -1.0f,-1.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f}),
-        Triangle({1.0f, 1.0f,-1.0f,
-        -1.0f,-1.0f,-1.0f,
-        -1.0f, 1.0f,-1.0f}),
-        Triangle({1.0f,-1.0f, 1.0f,
-        -1.0f,-1.0f,-1.0f,
-        1.0f,-1.0f,-1.0f}),
-        Triangle({1.0f, 1.0f,-1.0f,
-        1.0f,-1.0f,-1.0f,
-        -1.0f,-1.0f,-1.0f}),
-        Triangle({-1.0f,-1.0f,-1.0f,
-        -1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f,-1.0f}),
-        Triangle({1.0f,-1.0f, 1.0f,
-        -1.0f,-1.0f, 1.0f,
-        -1.0f,-1.0f,-1.0f}),
-        Triangle({-1.0f, 1.0f, 1.0f,
-        -1.0f,-1.0f, 1.0f,
-        1.0f,-1.0f, 1.0f}),
-        Triangle({1.0f, 1.0f, 1.0f,
-        1.0f,-1.0f,-1.0f,
-        1.0f, 1.0f,-1.0f}),
-        Triangle({1.0f,-1.0f,-1.0f,
-        1.0f, 1.0f, 1.0f,
-        1.0f,-1.0f, 1.0f}),
-        Triangle({1.0f, 1.0f, 1.0f,
-        1.0f, 1.0f,-1.0f,
-        -1.0f, 1.0f,-1.0f}),
-        Triangle({1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f,-1.0f,
-        -1.0f, 1.0f, 1.0f}),
-        Triangle({1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f,
-        1.0f,-1.0f, 1.0f})
+
+// Constant speed motion in closed form, the same the instanced vertex shader
+// evaluates: at time t the center is spawn_center + speed * (t - spawn_time).
+struct Body {
+    glm::vec3 center = glm::vec3(0, 0, 0);
+    glm::vec3 spawn_center = glm::vec3(0, 0, 0);
+    double spawn_time = 0;
+
+    // starts the motion from the current center
+    void spawn(double time) {
+        spawn_center = center;
+        spawn_time = time;
+    }
+
+    void animate(const glm::vec3& speed, double time) {
+        center = spawn_center + speed * float(time - spawn_time);
+    }
 };
 
 
-class Target : public Object {
-    int lifetime;
+// A fireball in flight, an instance of FireballMesh scaled by radius.
+class Fireball : public Body {
 public:
     GLfloat radius;
+    glm::vec3 color;
 
-    Target(const glm::vec3& icenter,
-            GLfloat radius,
-            const glm::vec3& angle,
-            const std::vector<GLfloat>& icolor,
-            int lifetime
-            ) : lifetime(lifetime), radius(radius) {
-        triangles = std::vector<Triangle>(CUBE_TRIANGLES);
-        colors = icolor;
-        center = icenter;
-        for (auto& t : triangles) {
-            t.stretch(radius);
-            t.turn(angle);
-            t.move(icenter);
-        }
-    }
-    bool expired(int timestamp) const {
-        return timestamp >= lifetime;
-    }
+    explicit Fireball(GLfloat radius, const glm::vec3& color=glm::vec3(0, 0, 0)) : radius(radius), color(color) {}
 };
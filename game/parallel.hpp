@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for data parallel loops.
+// parallel_for() splits [0, count) into chunks of grain items that workers and
+// the calling thread take in turn; it returns when every chunk is done.
+class WorkerPool {
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    const std::function<void(size_t, size_t)>* _job = nullptr;
+    size_t _count = 0;
+    size_t _grain = 1;
+    std::atomic<size_t> _next{0};
+    size_t _busy = 0;          // workers still in the current job
+    uint64_t _generation = 0;  // bumped for every job
+    bool _stop = false;
+
+    void work() {
+        for (;;) {
+            size_t begin = _next.fetch_add(_grain, std::memory_order_relaxed);
+            if (begin >= _count) {
+                return;
+            }
+            (*_job)(begin, std::min(begin + _grain, _count));
+        }
+    }
+
+    void run() {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&] { return _stop || _generation != seen; });
+                if (_stop) {
+                    return;
+                }
+                seen = _generation;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_busy == 0) {
+                _done.notify_one();
+            }
+        }
+    }
+
+public:
+    // threads in addition to the caller, by default one per remaining core
+    explicit WorkerPool(size_t threads=std::max(std::thread::hardware_concurrency(), 1u) - 1) {
+        for (size_t i = 0; i < threads; ++i) {
+            _threads.emplace_back(&WorkerPool::run, this);
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    // threads working on a job, the caller included
+    size_t size() const {
+        return _threads.size() + 1;
+    }
+
+    // body(begin, end) is called concurrently for disjoint chunks
+    template <typename Body>
+    void parallel_for(size_t count, size_t grain, Body body) {
+        grain = std::max(grain, size_t(1));
+        if (_threads.empty() || count <= grain) {
+            if (count > 0) {
+                body(size_t(0), count);
+            }
+            return;
+        }
+        const std::function<void(size_t, size_t)> job = body;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _job = &job;
+            _count = count;
+            _grain = grain;
+            _next.store(0, std::memory_order_relaxed);
+            _busy = _threads.size();
+            ++_generation;
+        }
+        _wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&] { return _busy == 0; });
+        _job = nullptr;
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "objects.hpp"
+#include "parallel.hpp"
+#include "random.hpp"
+
+// CPU particles for fireball trails and hit bursts.
+//
+// Particles live in a fixed capacity pool stored as structure of arrays, so
+// the update walks every attribute as a contiguous float stream the compiler
+// vectorizes, and chunks of it run on a WorkerPool. Live particles are packed
+// at the front: a dead particle is replaced by the last live one. Particles
+// emitted into a full pool are dropped. They are drawn as GL_POINTS.
+
+struct ParticleEmitter {
+    glm::vec3 velocity;  // shared by all particles of an emission
+    float spread;        // plus a random velocity in a cube of this half size
+    glm::vec3 color;
+    float lifetime;      // seconds, randomly up to 50% longer
+};
+
+
+class ParticleSystem {
+    size_t _capacity;
+    size_t _count = 0;
+    size_t _dropped = 0;
+    std::vector<float> _x, _y, _z;
+    std::vector<float> _vx, _vy, _vz;
+    std::vector<float> _life;  // seconds left
+    std::vector<float> _fade;  // 1 / lifetime, brightness is life * fade
+    std::vector<float> _r, _g, _b;
+    Random::Stream _random;
+
+    void move(size_t from, size_t to) {
+        _x[to] = _x[from]; _y[to] = _y[from]; _z[to] = _z[from];
+        _vx[to] = _vx[from]; _vy[to] = _vy[from]; _vz[to] = _vz[from];
+        _life[to] = _life[from];
+        _fade[to] = _fade[from];
+        _r[to] = _r[from]; _g[to] = _g[from]; _b[to] = _b[from];
+    }
+
+public:
+    // particles per parallel chunk, large enough to amortize the hand-off
+    static constexpr size_t GRAIN = 16384;
+
+    glm::vec3 gravity = glm::vec3(0, -4, 0);
+    float drag = 1.5f;  // fraction of the speed lost per second
+
+    explicit ParticleSystem(size_t capacity, uint64_t seed=0)
+        : _capacity(capacity),
+          _x(capacity), _y(capacity), _z(capacity),
+          _vx(capacity), _vy(capacity), _vz(capacity),
+          _life(capacity), _fade(capacity),
+          _r(capacity), _g(capacity), _b(capacity),
+          _random(seed, Random::Purpose::PARTICLES) {}
+
+    size_t size() const {
+        return _count;
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    // particles lost to a full pool since the last call
+    size_t take_dropped() {
+        size_t dropped = _dropped;
+        _dropped = 0;
+        return dropped;
+    }
+
+    void emit(const glm::vec3& position, const ParticleEmitter& emitter, size_t count) {
+        if (count > _capacity - _count) {
+            _dropped += count - (_capacity - _count);
+            count = _capacity - _count;
+        }
+        for (size_t i = _count; i < _count + count; ++i) {
+            _x[i] = position.x;
+            _y[i] = position.y;
+            _z[i] = position.z;
+            _vx[i] = emitter.velocity.x + emitter.spread * _random.uniform(-1.0f, 1.0f);
+            _vy[i] = emitter.velocity.y + emitter.spread * _random.uniform(-1.0f, 1.0f);
+            _vz[i] = emitter.velocity.z + emitter.spread * _random.uniform(-1.0f, 1.0f);
+            _life[i] = emitter.lifetime * (1.25f + 0.25f * _random.uniform(-1.0f, 1.0f));
+            _fade[i] = 1.0f / _life[i];
+            _r[i] = emitter.color.x;
+            _g[i] = emitter.color.y;
+            _b[i] = emitter.color.z;
+        }
+        _count += count;
+    }
+
+    void update(float dt, WorkerPool& pool) {
+        const float damping = std::max(0.0f, 1.0f - drag * dt);
+        const glm::vec3 kick = gravity * dt;
+        pool.parallel_for(_count, GRAIN, [&](size_t begin, size_t end) {
+            float* x = _x.data();
+            float* y = _y.data();
+            float* z = _z.data();
+            float* vx = _vx.data();
+            float* vy = _vy.data();
+            float* vz = _vz.data();
+            float* life = _life.data();
+            // branch free so the compiler can vectorize it
+            for (size_t i = begin; i < end; ++i) {
+                vx[i] = vx[i] * damping + kick.x;
+                vy[i] = vy[i] * damping + kick.y;
+                vz[i] = vz[i] * damping + kick.z;
+                x[i] += vx[i] * dt;
+                y[i] += vy[i] * dt;
+                z[i] += vz[i] * dt;
+                life[i] -= dt;
+            }
+        });
+
+        for (size_t i = 0; i < _count;) {
+            if (_life[i] > 0) {
+                ++i;
+            } else {
+                move(--_count, i);
+            }
+        }
+    }
+
+    // points fade out towards the end of their life
+    BufferRange draw(Buffer& buffer, WorkerPool& pool) const {
+        return buffer.add_points(_count, [&](GLfloat* positions, GLfloat* colors) {
+            pool.parallel_for(_count, GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    float brightness = std::min(_life[i] * _fade[i], 1.0f);
+                    positions[3 * i] = _x[i];
+                    positions[3 * i + 1] = _y[i];
+                    positions[3 * i + 2] = _z[i];
+                    colors[3 * i] = _r[i] * brightness;
+                    colors[3 * i + 1] = _g[i] * brightness;
+                    colors[3 * i + 2] = _b[i] * brightness;
+                }
+            });
+        });
+    }
+};
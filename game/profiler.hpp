@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "timing.hpp"
+#include "log.hpp"
+
+// Where the time of a frame goes, on the CPU and on the GPU.
+//
+// A zone is timed by the CPU clock between begin() and end(), and, when the
+// driver has ARB_timer_query, by GL_TIMESTAMP queries at the same two points.
+// Timestamps rather than GL_TIME_ELAPSED, as only one elapsed query can be
+// open at a time and zones may nest. Queries are kept in a ring of LATENCY
+// frames and a frame's results are read when its slot comes round again, so
+// reading never waits for the GPU; results not ready by then are dropped and
+// counted. Without the extension only CPU times are reported.
+class FrameProfiler {
+public:
+    static constexpr size_t LATENCY = 4;  // frames of queries in flight
+
+    struct Zone {
+        std::string name;
+        bool gpu;  // false for zones that issue no GL commands
+        uint64_t count = 0;
+        double cpu_time = 0;  // sums over the reporting period, seconds
+        double gpu_time = 0;
+        uint64_t gpu_count = 0;
+    };
+
+private:
+    struct Slot {
+        std::vector<GLuint> queries;  // begin and end per zone
+        std::vector<uint8_t> used;    // zones timed in this frame
+        bool pending = false;
+    };
+
+    const Clock& _clock;
+    bool _gpu;
+    std::vector<Zone> _zones;
+    std::vector<double> _cpu_start;
+    std::array<Slot, LATENCY> _slots;
+    size_t _frame = 0;
+    uint64_t _dropped = 0;  // frames of GPU results not ready in time
+
+    Slot& current() {
+        return _slots[_frame % LATENCY];
+    }
+
+    // Reads the frame last timed in slot, if the GPU is done with it.
+    void collect(Slot& slot) {
+        if (!slot.pending) {
+            return;
+        }
+        slot.pending = false;
+        // queries complete in order, the last one written stands for the frame
+        GLuint last = 0;
+        for (size_t zone = 0; zone < _zones.size(); ++zone) {
+            if (slot.used[zone]) {
+                last = slot.queries[2 * zone + 1];
+            }
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            ++_dropped;
+            return;
+        }
+        for (size_t zone = 0; zone < _zones.size(); ++zone) {
+            if (!slot.used[zone]) {
+                continue;
+            }
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(slot.queries[2 * zone], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(slot.queries[2 * zone + 1], GL_QUERY_RESULT, &end);
+            _zones[zone].gpu_time += (end - begin) * 1e-9;
+            _zones[zone].gpu_count += 1;
+        }
+    }
+
+public:
+    // Call with a current GL context, after GLEW is initialised.
+    explicit FrameProfiler(const Clock& clock) : _clock(clock), _gpu(GLEW_ARB_timer_query) {}
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // called explicitly, like Mesh::release()
+    void release() {
+        for (auto& slot : _slots) {
+            if (!slot.queries.empty()) {
+                glDeleteQueries(GLsizei(slot.queries.size()), slot.queries.data());
+                slot.queries.clear();
+            }
+        }
+    }
+
+    bool gpu_timing() const {
+        return _gpu;
+    }
+
+    const std::vector<Zone>& zones() const {
+        return _zones;
+    }
+
+    // Adds a zone before the first frame, returns its id for begin() and end().
+    size_t add_zone(const char* name, bool gpu=true) {
+        _zones.push_back(Zone{name, gpu && _gpu});
+        _cpu_start.push_back(0);
+        if (_gpu) {
+            for (auto& slot : _slots) {
+                slot.queries.resize(2 * _zones.size());
+                slot.used.resize(_zones.size());
+                glGenQueries(2, &slot.queries[2 * (_zones.size() - 1)]);
+            }
+        }
+        return _zones.size() - 1;
+    }
+
+    // Starts a frame: results of the frame LATENCY frames ago are read first.
+    void begin_frame() {
+        ++_frame;
+        if (!_gpu) {
+            return;
+        }
+        Slot& slot = current();
+        collect(slot);
+        std::fill(slot.used.begin(), slot.used.end(), 0);
+    }
+
+    void begin(size_t zone) {
+        _cpu_start[zone] = _clock.now();
+        if (_zones[zone].gpu) {
+            glQueryCounter(current().queries[2 * zone], GL_TIMESTAMP);
+        }
+    }
+
+    void end(size_t zone) {
+        if (_zones[zone].gpu) {
+            Slot& slot = current();
+            glQueryCounter(slot.queries[2 * zone + 1], GL_TIMESTAMP);
+            slot.used[zone] = 1;
+            slot.pending = true;
+        }
+        _zones[zone].cpu_time += _clock.now() - _cpu_start[zone];
+        _zones[zone].count += 1;
+    }
+
+    // Logs milliseconds per frame of every zone and starts a new period.
+    void log_report() {
+        std::string line;
+        for (auto& zone : _zones) {
+            char text[96];
+            double cpu_ms = zone.count ? 1000 * zone.cpu_time / zone.count : 0;
+            if (zone.gpu && zone.gpu_count > 0) {
+                snprintf(text, sizeof(text), "%s%s %.2f / %.2f", line.empty() ? "" : ", ",
+                    zone.name.c_str(), cpu_ms, 1000 * zone.gpu_time / zone.gpu_count);
+            } else {
+                snprintf(text, sizeof(text), "%s%s %.2f / -", line.empty() ? "" : ", ", zone.name.c_str(), cpu_ms);
+            }
+            line += text;
+            zone.count = 0;
+            zone.cpu_time = 0;
+            zone.gpu_time = 0;
+            zone.gpu_count = 0;
+        }
+        if (_gpu) {
+            LOG_INFO("cpu / gpu ms per frame: %s; %llu frames of gpu results late",
+                line.c_str(), (unsigned long long)_dropped);
+        } else {
+            LOG_INFO("cpu / gpu ms per frame: %s; no ARB_timer_query, gpu not timed", line.c_str());
+        }
+        _dropped = 0;
+    }
+};
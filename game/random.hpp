@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Counter-based random numbers.
+//
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// maps a 128 bit counter and a 64 bit key to 128 random bits with no state in
+// between, so the numbers for entity n can be computed on any thread in any
+// order and still come out the same. Stream wraps it in a sequential generator
+// for serial code.
+//
+// Generators of one world share the seed as key. The last counter word holds
+// what the numbers are for, so generators of different purposes never draw the
+// same block, whatever they put in the other three words.
+namespace Random {
+
+enum class Purpose : uint32_t {
+    TARGETS,    // TargetSpawner
+    PARTICLES,  // particle velocities and lifetimes
+    TRAILS,     // particles left behind by fireballs
+};
+
+class Philox {
+    uint32_t _key[2];
+
+    static constexpr uint32_t M0 = 0xD2511F53;
+    static constexpr uint32_t M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9;
+    static constexpr uint32_t W1 = 0xBB67AE85;
+
+public:
+    explicit Philox(uint64_t key=0) : _key{uint32_t(key), uint32_t(key >> 32)} {}
+
+    std::array<uint32_t, 4> operator()(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3) const {
+        uint32_t k0 = _key[0];
+        uint32_t k1 = _key[1];
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = uint64_t(M0) * c0;
+            uint64_t p1 = uint64_t(M1) * c2;
+            c0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+            c2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+            c1 = uint32_t(p1);
+            c3 = uint32_t(p0);
+            k0 += W0;
+            k1 += W1;
+        }
+        return {c0, c1, c2, c3};
+    }
+};
+
+
+// [0, 1) from the top 24 bits, all a float holds
+inline float unit(uint32_t bits) {
+    return float(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+
+// Sequential numbers of one purpose; streams with different ids never overlap.
+class Stream {
+    Philox _philox;
+    Purpose _purpose;
+    uint32_t _id;
+    uint64_t _counter = 0;
+    std::array<uint32_t, 4> _block{};
+    unsigned _used = 4;
+
+public:
+    Stream(uint64_t seed, Purpose purpose, uint32_t id=0) : _philox(seed), _purpose(purpose), _id(id) {}
+
+    uint32_t next() {
+        if (_used == 4) {
+            _block = _philox(uint32_t(_counter), uint32_t(_counter >> 32), _id, uint32_t(_purpose));
+            ++_counter;
+            _used = 0;
+        }
+        return _block[_used++];
+    }
+
+    float uniform() {
+        return unit(next());
+    }
+
+    float uniform(float low, float high) {
+        return low + (high - low) * uniform();
+    }
+};
+
+}  // namespace Random
@@ -0,0 +1,528 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "objects.hpp"
+
+// Shader program with the texture it samples and the handles needed to set it up.
+struct Material {
+    GLuint program = 0;
+    GLuint texture = 0;  // 0 for flat colored materials
+    GLint mvp_id = -1;
+    GLint sampler_id = -1;
+    GLint position_id = -1;
+    GLint color_id = -1;
+    GLint uv_id = -1;
+    // set for programs drawing an InstanceArray
+    GLint time_id = -1;
+    GLint instance_start_id = -1;
+    GLint instance_velocity_id = -1;
+    GLint instance_angle_id = -1;
+    GLint instance_spin_id = -1;
+    GLint instance_color_id = -1;
+
+    Material() {}
+
+    Material(GLuint program, GLuint texture=0) : program(program), texture(texture) {
+        mvp_id = glGetUniformLocation(program, "MVP");
+        sampler_id = glGetUniformLocation(program, "myTextureSampler");
+        position_id = glGetAttribLocation(program, "vertexPosition_modelspace");
+        color_id = glGetAttribLocation(program, "vertexColor");
+        uv_id = glGetAttribLocation(program, "vertexUV");
+        time_id = glGetUniformLocation(program, "time");
+        instance_start_id = glGetAttribLocation(program, "instanceStart");
+        instance_velocity_id = glGetAttribLocation(program, "instanceVelocity");
+        instance_angle_id = glGetAttribLocation(program, "instanceAngle");
+        instance_spin_id = glGetAttribLocation(program, "instanceSpin");
+        instance_color_id = glGetAttribLocation(program, "instanceColor");
+    }
+};
+
+
+// GPU copy of a Buffer: one vertex buffer per attribute. Or, uploaded by
+// upload_indexed(), interleaved vertices with an index buffer and one color;
+// ranges of such a mesh count indices.
+class Mesh {
+    GLuint _vertexbuffer = 0;
+    GLuint _colorbuffer = 0;
+    GLuint _uvbuffer = 0;
+    GLuint _indexbuffer = 0;
+    GLsizei _stride = 0;     // bytes per interleaved vertex, 0 for one buffer per attribute
+    size_t _uv_offset = 0;   // of the uv in an interleaved vertex
+    GLfloat _color[3] = {0, 0, 0};
+    // Orders the mesh's draw items. Given at construction, unlike the buffer
+    // names, so a mesh sorts apart from the others before its first upload.
+    uint32_t _key = next_key();
+
+    static uint32_t next_key() {
+        static std::atomic<uint32_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // on first use rather than in the constructor, so meshes of worlds that
+    // are never drawn need no GL context
+    void create() {
+        if (_vertexbuffer == 0) {
+            glGenBuffers(1, &_vertexbuffer);
+            glGenBuffers(1, &_colorbuffer);
+            glGenBuffers(1, &_uvbuffer);
+        }
+    }
+
+public:
+    Mesh() = default;
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // takes the buffers, the other mesh is left empty
+    Mesh(Mesh&& other) noexcept
+        : _vertexbuffer(std::exchange(other._vertexbuffer, 0)),
+          _colorbuffer(std::exchange(other._colorbuffer, 0)),
+          _uvbuffer(std::exchange(other._uvbuffer, 0)),
+          _indexbuffer(std::exchange(other._indexbuffer, 0)),
+          _stride(other._stride), _uv_offset(other._uv_offset), _key(other._key) {
+        std::copy(other._color, other._color + 3, _color);
+    }
+
+    // called explicitly, the GL context is gone by the time destructors run
+    void release() {
+        if (_vertexbuffer != 0) {
+            glDeleteBuffers(1, &_vertexbuffer);
+            glDeleteBuffers(1, &_colorbuffer);
+            glDeleteBuffers(1, &_uvbuffer);
+            _vertexbuffer = _colorbuffer = _uvbuffer = 0;
+        }
+        if (_indexbuffer != 0) {
+            glDeleteBuffers(1, &_indexbuffer);
+            _indexbuffer = 0;
+        }
+    }
+
+    uint32_t key() const {
+        return _key;
+    }
+
+    bool indexed() const {
+        return _indexbuffer != 0;
+    }
+
+    void upload(Buffer& buffer) {
+        create();
+        glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * buffer.size(), buffer.vertex_data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, _colorbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * buffer.size(), buffer.color_data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, _uvbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * buffer.texture_size(), buffer.texture_data(), GL_STATIC_DRAW);
+    }
+
+    // storage for vertex_count vertices, filled by upload_range()
+    void allocate(size_t vertex_count, GLenum usage) {
+        create();
+        glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * vertex_count, NULL, usage);
+        glBindBuffer(GL_ARRAY_BUFFER, _colorbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * vertex_count, NULL, usage);
+        glBindBuffer(GL_ARRAY_BUFFER, _uvbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * vertex_count, NULL, usage);
+    }
+
+    void upload_range(Buffer& buffer, const BufferRange& range) {
+        create();
+        glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * range.first, sizeof(GLfloat) * 3 * range.count,
+            static_cast<const GLfloat*>(buffer.vertex_data()) + 3 * range.first);
+        glBindBuffer(GL_ARRAY_BUFFER, _colorbuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * range.first, sizeof(GLfloat) * 3 * range.count,
+            static_cast<const GLfloat*>(buffer.color_data()) + 3 * range.first);
+        glBindBuffer(GL_ARRAY_BUFFER, _uvbuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * range.first, sizeof(GLfloat) * 2 * range.count,
+            static_cast<const GLfloat*>(buffer.texture_data()) + 2 * range.first);
+    }
+
+    // Sends vertex_count interleaved vertices of stride bytes, position first and
+    // uv at uv_offset, and index_count indices as they are, in the order given.
+    void upload_indexed(const void* vertices, size_t vertex_count, GLsizei stride, size_t uv_offset,
+        const uint32_t* indices, size_t index_count, const glm::vec3& color) {
+        create();
+        if (_indexbuffer == 0) {
+            glGenBuffers(1, &_indexbuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+        glBufferData(GL_ARRAY_BUFFER, stride * vertex_count, vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexbuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * index_count, indices, GL_STATIC_DRAW);
+        _stride = stride;
+        _uv_offset = uv_offset;
+        _color[0] = color.x;
+        _color[1] = color.y;
+        _color[2] = color.z;
+    }
+
+    void bind(const Material& material) const {
+        if (material.position_id >= 0) {
+            glEnableVertexAttribArray(material.position_id);
+            glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+            glVertexAttribPointer(material.position_id, 3, GL_FLOAT, GL_FALSE, _stride, (void*)0);
+        }
+        if (material.color_id >= 0) {
+            if (indexed()) {
+                glDisableVertexAttribArray(material.color_id);
+                glVertexAttrib3fv(material.color_id, _color);
+            } else {
+                glEnableVertexAttribArray(material.color_id);
+                glBindBuffer(GL_ARRAY_BUFFER, _colorbuffer);
+                glVertexAttribPointer(material.color_id, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+            }
+        }
+        if (material.uv_id >= 0) {
+            glEnableVertexAttribArray(material.uv_id);
+            if (indexed()) {
+                glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+                glVertexAttribPointer(material.uv_id, 2, GL_FLOAT, GL_FALSE, _stride, (void*)_uv_offset);
+            } else {
+                glBindBuffer(GL_ARRAY_BUFFER, _uvbuffer);
+                glVertexAttribPointer(material.uv_id, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+            }
+        }
+        if (indexed()) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexbuffer);
+        }
+    }
+
+    static void unbind(const Material& material) {
+        if (material.position_id >= 0) glDisableVertexAttribArray(material.position_id);
+        if (material.color_id >= 0) glDisableVertexAttribArray(material.color_id);
+        if (material.uv_id >= 0) glDisableVertexAttribArray(material.uv_id);
+    }
+};
+
+
+// Motion of one instance as the instanced vertex shader evaluates it: at time t
+// the mesh is scaled, turned by angle + spin * (t - spawn time) and moved to
+// start + velocity * (t - spawn time).
+struct Instance {
+    GLfloat start[4];     // position at spawn, spawn time in w
+    GLfloat velocity[4];  // units per second, scale in w
+    GLfloat angle[3];
+    GLfloat spin[3];      // radians per second
+    GLfloat color[3];     // added to the vertex color
+};
+
+
+// Instances of one mesh in a vertex buffer, one entry per object.
+//
+// An entry is written when its object spawns and never again while the object
+// flies, so moving objects cost no uploads. Removal moves the last entry into
+// the hole, like removing from the game's object vectors, which keeps both in
+// the same order. Without ARB_instanced_arrays the entries are drawn one call
+// each, with the instance data passed as constant attributes.
+class InstanceArray {
+    GLuint _buffer = 0;
+    std::vector<Instance> _instances;
+    size_t _gpu_instances = 0;        // room in the GPU buffer
+    size_t _dirty_begin = SIZE_MAX;   // entries changed since the last upload
+    size_t _dirty_end = 0;
+    size_t _uploaded = 0;             // entries sent by the last upload()
+
+    void mark(size_t i) {
+        _dirty_begin = std::min(_dirty_begin, i);
+        _dirty_end = std::max(_dirty_end, i + 1);
+    }
+
+    template <typename Attribute>
+    static void for_each_attribute(const Material& material, Attribute attribute) {
+        attribute(material.instance_start_id, 4, offsetof(Instance, start));
+        attribute(material.instance_velocity_id, 4, offsetof(Instance, velocity));
+        attribute(material.instance_angle_id, 3, offsetof(Instance, angle));
+        attribute(material.instance_spin_id, 3, offsetof(Instance, spin));
+        attribute(material.instance_color_id, 3, offsetof(Instance, color));
+    }
+
+public:
+    InstanceArray() = default;
+
+    InstanceArray(const InstanceArray&) = delete;
+    InstanceArray& operator=(const InstanceArray&) = delete;
+
+    // called explicitly, like Mesh::release()
+    void release() {
+        if (_buffer != 0) {
+            glDeleteBuffers(1, &_buffer);
+            _buffer = 0;
+            _gpu_instances = 0;
+        }
+    }
+
+    static bool hardware_instancing() {
+        return GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+    }
+
+    size_t size() const {
+        return _instances.size();
+    }
+
+    size_t uploaded() const {
+        return _uploaded;
+    }
+
+    void add(const Instance& instance) {
+        MEMORY_TAG(TAG_BUFFER);
+        _instances.push_back(instance);
+        mark(_instances.size() - 1);
+    }
+
+    void remove(size_t i) {
+        if (i + 1 < _instances.size()) {
+            _instances[i] = _instances.back();
+            mark(i);
+        }
+        _instances.pop_back();
+    }
+
+    // Sends changed entries to the GPU.
+    void upload() {
+        _uploaded = 0;
+        if (!hardware_instancing()) {
+            return;  // drawn from the CPU copy
+        }
+        if (_buffer == 0) {
+            glGenBuffers(1, &_buffer);  // like Mesh, on first use
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        if (_instances.size() > _gpu_instances) {
+            // grown: reallocate with room to spare and send everything
+            _gpu_instances = std::max(_instances.size(), 2 * _gpu_instances);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * _gpu_instances, NULL, GL_DYNAMIC_DRAW);
+            _dirty_begin = 0;
+            _dirty_end = _instances.size();
+        }
+        _dirty_end = std::min(_dirty_end, _instances.size());
+        if (_dirty_begin < _dirty_end) {
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(Instance) * _dirty_begin,
+                sizeof(Instance) * (_dirty_end - _dirty_begin), &_instances[_dirty_begin]);
+            _uploaded = _dirty_end - _dirty_begin;
+        }
+        _dirty_begin = SIZE_MAX;
+        _dirty_end = 0;
+    }
+
+    // Draws range of the mesh bound for material once per instance, returns the draw calls made.
+    size_t draw(const Material& material, GLenum mode, const BufferRange& range) const {
+        if (_instances.empty()) {
+            return 0;
+        }
+        if (hardware_instancing()) {
+            glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+            for_each_attribute(material, [](GLint id, GLint size, size_t offset) {
+                if (id >= 0) {
+                    glEnableVertexAttribArray(id);
+                    glVertexAttribPointer(id, size, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offset);
+                    glVertexAttribDivisorARB(id, 1);
+                }
+            });
+            glDrawArraysInstancedARB(mode, range.first, range.count, GLsizei(_instances.size()));
+            for_each_attribute(material, [](GLint id, GLint, size_t) {
+                if (id >= 0) {
+                    glVertexAttribDivisorARB(id, 0);
+                    glDisableVertexAttribArray(id);
+                }
+            });
+            return 1;
+        }
+        for (const auto& instance : _instances) {
+            const GLfloat* data = reinterpret_cast<const GLfloat*>(&instance);
+            for_each_attribute(material, [data](GLint id, GLint size, size_t offset) {
+                if (id >= 0) {
+                    GLfloat value[4] = {0, 0, 0, 1};
+                    std::copy(data + offset / sizeof(GLfloat), data + offset / sizeof(GLfloat) + size, value);
+                    glVertexAttrib4fv(id, value);
+                }
+            });
+            glDrawArrays(mode, range.first, range.count);
+        }
+        return _instances.size();
+    }
+};
+
+
+struct DrawItem {
+    const Material* material;
+    const Mesh* mesh;
+    BufferRange range;
+    GLenum mode;  // GL_TRIANGLES or GL_POINTS
+    const InstanceArray* instances;  // range drawn once per instance, nullptr to draw it once
+    const glm::mat4* model;  // model to world transform, nullptr for world space vertices
+
+    // program is the most expensive switch, so it goes to the highest bits
+    uint64_t key() const {
+        return (uint64_t(material->program & 0xFFFFF) << 44)
+            | (uint64_t(material->texture & 0xFFFFF) << 24)
+            | uint64_t(mesh->key() & 0xFFFFFF);
+    }
+};
+
+
+struct RenderStats {
+    size_t items = 0;
+    size_t draw_calls = 0;
+    size_t state_changes = 0;
+};
+
+
+// Collects draw items for a frame, sorts them by state and
+// merges adjacent ranges with equal state into a single draw call.
+class RenderQueue {
+    std::vector<std::pair<uint64_t, DrawItem>> _items;
+    RenderStats _stats;
+    bool _sorted = false;
+public:
+    // model must stay valid until the queue is cleared
+    void submit(const Material& material, const Mesh& mesh, const BufferRange& range, GLenum mode=GL_TRIANGLES,
+        const glm::mat4* model=nullptr) {
+        if (range.count == 0) {
+            return;
+        }
+        DrawItem item{&material, &mesh, range, mode, nullptr, model};
+        _items.emplace_back(item.key(), item);
+    }
+
+    // Range of mesh placed by every entry of instances, and then by model when given.
+    // Both must stay valid until the queue is cleared.
+    void submit_instanced(const Material& material, const Mesh& mesh, const BufferRange& range,
+        const InstanceArray& instances, const glm::mat4* model=nullptr) {
+        if (range.count == 0 || instances.size() == 0) {
+            return;
+        }
+        DrawItem item{&material, &mesh, range, GL_TRIANGLES, &instances, model};
+        _items.emplace_back(item.key(), item);
+    }
+
+    const RenderStats& stats() const {
+        return _stats;
+    }
+
+    // Draws everything submitted since the last clear(). Can be called once per
+    // view; items are sorted only for the first one and stats add up over views.
+    // Instanced items are posed at time, in seconds.
+    void render(const glm::mat4& MVP, float time=0) {
+        if (!_sorted) {
+            _stats = RenderStats();
+            _stats.items = _items.size();
+            std::sort(_items.begin(), _items.end(), [](const auto& lhs, const auto& rhs) {
+                if (lhs.first != rhs.first) {
+                    return lhs.first < rhs.first;
+                }
+                return lhs.second.range.first < rhs.second.range.first;
+            });
+            _sorted = true;
+        }
+
+        const Material* material = nullptr;
+        const Mesh* mesh = nullptr;
+        GLuint texture = 0;
+        BufferRange pending{0, 0};
+        GLenum mode = GL_TRIANGLES;
+        const InstanceArray* instances = nullptr;
+        const glm::mat4* model = nullptr;
+
+        for (const auto& entry : _items) {
+            const DrawItem& item = entry.second;
+            bool same_state = material && mesh
+                && material->program == item.material->program
+                && texture == item.material->texture
+                && mesh == item.mesh
+                && mode == item.mode
+                && !instances && !item.instances
+                && !model && !item.model;
+            if (same_state && pending.first + pending.count == item.range.first) {
+                pending.count += item.range.count;
+                continue;
+            }
+            draw(pending, mode, material, mesh, instances);
+
+            bool program_changed = !material || material->program != item.material->program;
+            if (program_changed) {
+                if (material) {
+                    Mesh::unbind(*material);
+                }
+                glUseProgram(item.material->program);
+                glUniformMatrix4fv(item.material->mvp_id, 1, GL_FALSE, &MVP[0][0]);
+                if (item.material->time_id >= 0) {
+                    glUniform1f(item.material->time_id, time);
+                }
+                if (item.material->sampler_id >= 0) {
+                    glUniform1i(item.material->sampler_id, 0);
+                }
+                ++_stats.state_changes;
+            }
+            if (!material || texture != item.material->texture) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, item.material->texture);
+                texture = item.material->texture;
+                ++_stats.state_changes;
+            }
+            // attribute locations belong to the program, so rebind on either switch
+            if (program_changed || mesh != item.mesh) {
+                item.mesh->bind(*item.material);
+                ++_stats.state_changes;
+            }
+            // items with their own transform are drawn one by one
+            if (item.model) {
+                glm::mat4 item_mvp = MVP * *item.model;
+                glUniformMatrix4fv(item.material->mvp_id, 1, GL_FALSE, &item_mvp[0][0]);
+            } else if (model && !program_changed) {
+                glUniformMatrix4fv(item.material->mvp_id, 1, GL_FALSE, &MVP[0][0]);
+            }
+            model = item.model;
+            instances = item.instances;
+            material = item.material;
+            mesh = item.mesh;
+            pending = item.range;
+            mode = item.mode;
+        }
+        draw(pending, mode, material, mesh, instances);
+
+        if (material) {
+            Mesh::unbind(*material);
+        }
+    }
+
+    void clear() {
+        _items.clear();
+        _sorted = false;
+    }
+
+    void flush(const glm::mat4& MVP, float time=0) {
+        render(MVP, time);
+        clear();
+    }
+
+private:
+    void draw(const BufferRange& range, GLenum mode, const Material* material, const Mesh* mesh,
+        const InstanceArray* instances) {
+        if (range.count == 0) {
+            return;
+        }
+        if (instances) {
+            _stats.draw_calls += instances->draw(*material, mode, range);
+            return;
+        }
+        if (mesh->indexed()) {
+            glDrawElements(mode, range.count, GL_UNSIGNED_INT, (void*)(sizeof(uint32_t) * range.first));
+        } else {
+            glDrawArrays(mode, range.first, range.count);
+        }
+        ++_stats.draw_calls;
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Transform hierarchy in flat arrays.
+//
+// Nodes are stored parents first, so update() computes world matrices in a
+// single forward pass: a node is recomputed only when its local transform or
+// its parent's world matrix changed. Node ids stay stable while the arrays
+// are compacted. Destroying a node destroys its subtree; removals are batched
+// into the next update().
+class SceneGraph {
+public:
+    using NodeId = uint32_t;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+    // per slot, in topological order
+    std::vector<NodeId> _id;
+    std::vector<uint32_t> _parent;  // slot of the parent or NONE
+    std::vector<glm::mat4> _local;
+    std::vector<glm::mat4> _world;
+    std::vector<uint8_t> _dirty;
+    std::vector<uint8_t> _removed;
+    // per id
+    std::vector<uint32_t> _slot;
+    std::vector<NodeId> _free_ids;
+
+    bool _has_removed = false;
+    size_t _updated = 0;
+
+    void compact() {
+        std::vector<uint32_t> moved_to(_id.size(), NONE);
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < _id.size(); ++i) {
+            uint32_t parent = _parent[i];
+            if (_removed[i] || (parent != NONE && moved_to[parent] == NONE)) {
+                _slot[_id[i]] = NONE;
+                _free_ids.push_back(_id[i]);
+                continue;
+            }
+            _id[next] = _id[i];
+            _parent[next] = parent == NONE ? NONE : moved_to[parent];
+            _local[next] = _local[i];
+            _world[next] = _world[i];
+            _dirty[next] = _dirty[i];
+            _removed[next] = 0;
+            _slot[_id[next]] = next;
+            moved_to[i] = next++;
+        }
+        _id.resize(next);
+        _parent.resize(next);
+        _local.resize(next);
+        _world.resize(next);
+        _dirty.resize(next);
+        _removed.resize(next);
+        _has_removed = false;
+    }
+
+public:
+    // new node with an identity transform under parent, or a root
+    NodeId create(NodeId parent=NONE) {
+        NodeId id;
+        if (!_free_ids.empty()) {
+            id = _free_ids.back();
+            _free_ids.pop_back();
+        } else {
+            id = NodeId(_slot.size());
+            _slot.push_back(NONE);
+        }
+        uint32_t slot = uint32_t(_id.size());
+        uint32_t parent_slot = parent == NONE ? NONE : _slot[parent];
+        _slot[id] = slot;
+        _id.push_back(id);
+        _parent.push_back(parent_slot);
+        _local.push_back(glm::mat4(1.0f));
+        _world.push_back(glm::mat4(1.0f));
+        _dirty.push_back(1);
+        _removed.push_back(0);
+        return id;
+    }
+
+    void destroy(NodeId id) {
+        _removed[_slot[id]] = 1;
+        _has_removed = true;
+    }
+
+    void set_local(NodeId id, const glm::mat4& local) {
+        uint32_t slot = _slot[id];
+        _local[slot] = local;
+        _dirty[slot] = 1;
+    }
+
+    const glm::mat4& local(NodeId id) const {
+        return _local[_slot[id]];
+    }
+
+    // As of the last update(). The reference is valid until a node is created.
+    const glm::mat4& world(NodeId id) const {
+        return _world[_slot[id]];
+    }
+
+    size_t size() const {
+        return _id.size();
+    }
+
+    // world matrices recomputed by the last update()
+    size_t updated() const {
+        return _updated;
+    }
+
+    void update() {
+        if (_has_removed) {
+            compact();
+        }
+        _updated = 0;
+        for (uint32_t i = 0; i < _id.size(); ++i) {
+            uint32_t parent = _parent[i];
+            if (parent != NONE && _dirty[parent]) {
+                _dirty[i] = 1;
+            }
+            if (_dirty[i]) {
+                _world[i] = parent == NONE ? _local[i] : _world[parent] * _local[i];
+                ++_updated;
+            }
+        }
+        std::fill(_dirty.begin(), _dirty.end(), 0);
+    }
+};
@@ -0,0 +1,447 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "objects.hpp"
+#include "controls.hpp"
+#include "render_queue.hpp"
+#include "geometry_cache.hpp"
+#include "world_grid.hpp"
+#include "snapshot.hpp"
+#include "collision.hpp"
+#include "input.hpp"
+#include "parallel.hpp"
+#include "particles.hpp"
+#include "random.hpp"
+#include "spawner.hpp"
+#include "targets.hpp"
+
+// gameplay tuning, times in seconds and speeds in units per second
+const float TARGET_SPAWN_RATE = 18.0f;  // targets per second
+const TargetSpawner::Settings TARGET_SPAWNS{
+    5.0f,         // ring around the player
+    0.1f, 3.1f,   // height
+    0.1f, 0.15f,  // radius
+    0.6f,         // max speed per axis
+    2.0f,         // max spin per axis, radians per second
+    16.0f         // lifetime per unit of brightness
+};
+const float FIREBALL_SPEED = 30.0f;
+const float FIREBALL_RADIUS = 0.5f;
+const glm::vec3 MUZZLE_OFFSET(0, -1, 0);  // where fireballs start, from the player's eyes
+const float FIREBALL_COOLDOWN = 0.33f;
+const size_t PARTICLE_CAPACITY = 1 << 20;
+const float FIREBALL_TRAIL_RATE = 600.0f;  // particles per second per fireball
+const size_t HIT_BURST = 2000;             // particles per collision
+
+const ParticleEmitter HIT_SPARKS{glm::vec3(0, 1, 0), 3.0f, glm::vec3(1.0f, 0.9f, 0.3f), 0.8f};
+
+// world streaming, distances in cells
+const float WORLD_CELL_SIZE = 20.0f;  // one floor tile
+const int WORLD_ACTIVE_RADIUS = 1;    // simulated and drawn around the player's cell
+const int WORLD_KEEP_RADIUS = 4;      // kept in memory, further cells go to the world directory
+
+struct CollisionPass {
+    Collision::BroadPhase broad_phase;
+    Collision::SweptSphereObbBatch narrow_phase;
+    std::vector<Collision::Aabb> target_bounds;
+    std::vector<Collision::Aabb> fireball_bounds;
+    std::vector<std::pair<uint32_t, uint32_t>> candidates;
+};
+
+// Fireball/target pairs that touch at any moment of this tick's motion, from time:
+// swept bounds pick the candidates, then fireball spheres are swept against target boxes.
+inline std::vector<Collision::Hit> find_collisions(CollisionPass& pass, double time, float dt, const Targets& targets,
+    const std::vector<Fireball>& fireballs, const std::vector<glm::vec3>& fireball_speeds) {
+    pass.target_bounds.clear();
+    for (size_t i = 0; i < targets.size(); ++i) {
+        pass.target_bounds.push_back(Collision::swept_bounds(
+            targets.center(i), targets.speed(i) * dt, targets.bounding_radius(i)));
+    }
+    pass.fireball_bounds.clear();
+    for (size_t j = 0; j < fireballs.size(); ++j) {
+        pass.fireball_bounds.push_back(Collision::swept_bounds(
+            fireballs[j].center, fireball_speeds[j] * dt, fireballs[j].radius));
+    }
+    pass.broad_phase.find_pairs(pass.target_bounds, pass.fireball_bounds, pass.candidates);
+
+    pass.narrow_phase.clear();
+    for (const auto& candidate : pass.candidates) {
+        uint32_t i = candidate.first;
+        uint32_t j = candidate.second;
+        pass.narrow_phase.add(targets.obb(i, time), targets.speed(i) * dt,
+            fireballs[j].center, fireball_speeds[j] * dt, fireballs[j].radius, i, j);
+    }
+    pass.narrow_phase.solve();
+
+    std::vector<Collision::Hit> hits;
+    for (size_t k = 0; k < pass.narrow_phase.size(); ++k) {
+        if (pass.narrow_phase.time(k) <= 1.0f) {
+            hits.push_back(Collision::Hit{pass.narrow_phase.time(k),
+                pass.narrow_phase.box_id[k], pass.narrow_phase.sphere_id[k]});
+        }
+    }
+    return Collision::resolve_hits(hits, targets.size(), fireballs.size());
+}
+
+
+// Instances are written once, at spawn: the shader moves them from there on.
+inline Instance target_instance(const Targets& targets, size_t i) {
+    glm::vec3 start = targets.spawn_center(i);
+    glm::vec3 speed = targets.speed(i);
+    glm::vec3 angle = targets.spawn_angle(i);
+    glm::vec3 spin = targets.spin(i);
+    glm::vec3 color = targets.color(i);
+    return Instance{
+        {start.x, start.y, start.z, float(targets.spawn_time(i))},
+        {speed.x, speed.y, speed.z, targets.radius(i)},
+        {angle.x, angle.y, angle.z},
+        {spin.x, spin.y, spin.z},
+        {color.x, color.y, color.z}
+    };
+}
+
+inline Instance fireball_instance(const Fireball& fireball, const glm::vec3& speed) {
+    const glm::vec3& color = fireball.color;
+    const glm::vec3& start = fireball.spawn_center;
+    return Instance{
+        {start.x, start.y, start.z, float(fireball.spawn_time)},
+        {speed.x, speed.y, speed.z, fireball.radius},
+        {0, 0, 0},
+        {0, 0, 0},
+        {color.x, color.y, color.z}
+    };
+}
+
+
+// The last object takes the place of the removed one, in the instances too.
+template <typename T>
+void remove_object(InstanceArray& instances, std::vector<T>& objects, std::vector<glm::vec3>& speeds, size_t id=0) {
+    if (objects.size() > id) {
+        objects[id] = std::move(objects.back());
+        objects.pop_back();
+        speeds[id] = speeds.back();
+        speeds.pop_back();
+        instances.remove(id);
+    }
+}
+
+inline void remove_object(InstanceArray& instances, Targets& targets, size_t id) {
+    if (targets.size() > id) {
+        targets.remove(id);
+        instances.remove(id);
+    }
+}
+
+// removes objects ids with remove(id)
+template <typename Remove>
+void remove_objects(std::vector<uint32_t> ids, Remove remove) {
+    // from the back, so the objects moved into the holes are never ones still to remove
+    std::sort(ids.begin(), ids.end());
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+        remove(*it);
+    }
+}
+
+
+// target i as it is at time
+inline Snapshot::EntityRecord target_record(const Targets& targets, size_t i, double time) {
+    glm::vec3 center = targets.center(i);
+    glm::vec3 speed = targets.speed(i);
+    glm::vec3 angle = targets.angle(i, time);
+    glm::vec3 spin = targets.spin(i);
+    glm::vec3 color = targets.color(i);
+    return Snapshot::EntityRecord{
+        Snapshot::ENTITY_TARGET, 0, targets.lifetime(i),
+        {center.x, center.y, center.z},
+        {speed.x, speed.y, speed.z},
+        {angle.x, angle.y, angle.z},
+        {spin.x, spin.y, spin.z},
+        targets.radius(i),
+        {color.x, color.y, color.z}
+    };
+}
+
+inline Snapshot::EntityRecord fireball_record(const Fireball& fireball, const glm::vec3& speed) {
+    const glm::vec3& color = fireball.color;
+    return Snapshot::EntityRecord{
+        Snapshot::ENTITY_FIREBALL, 0, 0,
+        {fireball.center.x, fireball.center.y, fireball.center.z},
+        {speed.x, speed.y, speed.z},
+        {0, 0, 0},
+        {0, 0, 0},
+        fireball.radius,
+        {color.x, color.y, color.z}
+    };
+}
+
+
+// One game world: the player, targets, fireballs, particles and the streamed
+// grid of cells, advanced in fixed ticks.
+//
+// It owns all of its state, random streams included, and touches no GL: the
+// game draws from the public members, and a batch runs many of these side by
+// side on a thread pool. Worlds with the same seed and input come out the same.
+// Floor tiles of the grid are written to the given GeometryCache, which is only
+// uploaded by the caller.
+class Simulation {
+public:
+    struct Settings {
+        uint64_t seed = 0;
+        size_t wave = 0;             // targets spawned at once every wave_interval, 0 for none
+        double wave_interval = 10;  // seconds between waves, the first one at the start
+        size_t particle_capacity = PARTICLE_CAPACITY;  // 0 for a world nobody watches
+        std::string world_dir;       // where far world cells are written, empty to keep them in memory
+    };
+
+    // what happened in one tick
+    struct Events {
+        size_t spawned = 0;
+        size_t expired = 0;
+        size_t collisions = 0;
+        size_t fired = 0;
+    };
+
+    // totals since the start
+    struct Stats {
+        uint64_t ticks = 0;
+        uint64_t spawned = 0;
+        uint64_t expired = 0;
+        uint64_t collisions = 0;
+        uint64_t fired = 0;
+        size_t peak_targets = 0;
+    };
+
+private:
+    WorkerPool& _workers;
+    GeometryCache& _tiles;
+    CollisionPass _collision_pass;
+    TargetSpawner _spawner;
+    TargetBatch _spawn_batch;
+    Random::Stream _random;
+    size_t _wave;
+    double _wave_interval;
+    float _spawn_budget = 0;  // targets owed by the steady spawn rate
+    double _next_wave;
+    double _last_shoot_time;
+    Stats _stats;
+
+    void add_targets(const TargetBatch& batch) {
+        MEMORY_TAG(TAG_ENTITY);
+        size_t first = targets.size();
+        targets.append(batch, time);
+        for (size_t i = first; i < targets.size(); ++i) {
+            target_instances.add(target_instance(targets, i));
+        }
+    }
+
+    void restore_target(const Snapshot::EntityRecord& entity) {
+        MEMORY_TAG(TAG_ENTITY);
+        glm::vec3 center(entity.center[0], entity.center[1], entity.center[2]);
+        glm::vec3 angle(entity.angle[0], entity.angle[1], entity.angle[2]);
+        glm::vec3 spin(entity.spin[0], entity.spin[1], entity.spin[2]);
+        glm::vec3 speed(entity.speed[0], entity.speed[1], entity.speed[2]);
+        glm::vec3 color(entity.color[0], entity.color[1], entity.color[2]);
+        targets.add(center, entity.radius, angle, spin, speed, color, entity.lifetime, time);
+        target_instances.add(target_instance(targets, targets.size() - 1));
+    }
+
+    void create_fireball(const glm::vec3& direction) {
+        MEMORY_TAG(TAG_ENTITY);
+        Fireball fireball(FIREBALL_RADIUS);
+        fireball.center = muzzle();
+        fireball.spawn(time);
+        fireballs.emplace_back(fireball);
+        fireball_speeds.emplace_back(direction * FIREBALL_SPEED);
+        fireball_instances.add(fireball_instance(fireballs.back(), fireball_speeds.back()));
+    }
+
+public:
+    // the instances are kept in the order of the objects
+    Targets targets;
+    InstanceArray target_instances;
+    std::vector<Fireball> fireballs;
+    std::vector<glm::vec3> fireball_speeds;
+    InstanceArray fireball_instances;
+
+    Controls controls;
+    ParticleSystem particles;
+    WorldGrid world;
+    double time;
+
+    // workers run the data parallel parts of a tick; a world that is itself
+    // run by a pool job needs one of its own, see WorkerPool
+    Simulation(const Settings& settings, const Floor& floor, GeometryCache& tiles, WorkerPool& workers,
+        double start_time=0)
+        : _workers(workers), _tiles(tiles),
+          _spawner(TARGET_SPAWNS, settings.seed), _random(settings.seed, Random::Purpose::TRAILS),
+          _wave(settings.wave), _wave_interval(settings.wave_interval),
+          _next_wave(start_time), _last_shoot_time(start_time),
+          particles(settings.particle_capacity, settings.seed),
+          world(floor, WORLD_CELL_SIZE, WORLD_ACTIVE_RADIUS, WORLD_KEEP_RADIUS, settings.world_dir),
+          time(start_time) {}
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    const Stats& stats() const {
+        return _stats;
+    }
+
+    glm::vec3 muzzle() const {
+        return controls.position + MUZZLE_OFFSET;
+    }
+
+    // Spawns targets around the player outside of the steady rate and the waves.
+    void spawn(size_t count) {
+        if (count == 0) {
+            return;
+        }
+        _spawner.generate(count, time, controls.position, _spawn_batch, _workers);
+        add_targets(_spawn_batch);
+        _stats.spawned += count;
+    }
+
+    // Fires a fireball along a unit direction, not held to FIREBALL_COOLDOWN.
+    void fire(const glm::vec3& direction) {
+        create_fireball(direction);
+        _stats.fired += 1;
+    }
+
+    // Brings back targets and fireballs saved in a snapshot.
+    void restore(const std::vector<Snapshot::EntityRecord>& entities) {
+        MEMORY_TAG(TAG_ENTITY);
+        for (const auto& entity : entities) {
+            if (entity.kind == Snapshot::ENTITY_TARGET) {
+                restore_target(entity);
+            } else if (entity.kind == Snapshot::ENTITY_FIREBALL) {
+                glm::vec3 speed(entity.speed[0], entity.speed[1], entity.speed[2]);
+                Fireball fireball(entity.radius, glm::vec3(entity.color[0], entity.color[1], entity.color[2]));
+                fireball.center = glm::vec3(entity.center[0], entity.center[1], entity.center[2]);
+                fireball.spawn(time);
+                fireballs.push_back(fireball);
+                fireball_speeds.push_back(speed);
+                fireball_instances.add(fireball_instance(fireball, speed));
+            }
+        }
+    }
+
+    // Every target and fireball, stored cells included.
+    std::vector<Snapshot::EntityRecord> records() const {
+        std::vector<Snapshot::EntityRecord> result;
+        for (size_t i = 0; i < targets.size(); ++i) {
+            result.push_back(target_record(targets, i, time));
+        }
+        // targets of cells away from the player
+        for (const auto& record : world.stored_records()) {
+            result.push_back(record);
+        }
+        for (size_t i = 0; i < fireballs.size(); ++i) {
+            result.push_back(fireball_record(fireballs[i], fireball_speeds[i]));
+        }
+        return result;
+    }
+
+    Events tick(float dt, const TickInput& input) {
+        Events events;
+        controls.updateFromInput(input);
+
+        // create targets: the steady trickle plus the waves
+        _spawn_budget += TARGET_SPAWN_RATE * dt;
+        size_t spawn_count = size_t(_spawn_budget);
+        _spawn_budget -= spawn_count;
+        if (_wave > 0 && time >= _next_wave) {
+            spawn_count += _wave;
+            _next_wave = _wave_interval > 0 ? _next_wave + _wave_interval : INFINITY;
+        }
+        if (spawn_count > 0) {
+            _spawner.generate(spawn_count, time, controls.position, _spawn_batch, _workers);
+            add_targets(_spawn_batch);
+            events.spawned = spawn_count;
+        }
+
+        // remove expired targets
+        for (size_t i = targets.size(); i-- > 0;) {
+            if (targets.expired(i, time)) {
+                remove_object(target_instances, targets, i);
+                ++events.expired;
+            }
+        }
+
+        // remove collided objects
+        auto hits = find_collisions(_collision_pass, time, dt, targets, fireballs, fireball_speeds);
+        events.collisions = hits.size();
+        std::vector<uint32_t> hit_targets;
+        std::vector<uint32_t> hit_fireballs;
+        for (const auto& hit : hits) {
+            hit_targets.push_back(hit.first);
+            hit_fireballs.push_back(hit.second);
+            // sparks in the target's color, brightened towards white
+            ParticleEmitter sparks = HIT_SPARKS;
+            sparks.color = (sparks.color + targets.color(hit.first)) * 0.5f;
+            particles.emit(targets.center(hit.first), sparks, HIT_BURST);
+        }
+        remove_objects(hit_targets, [this](size_t i) {
+            remove_object(target_instances, targets, i);
+        });
+        remove_objects(hit_fireballs, [this](size_t i) {
+            remove_object(fireball_instances, fireballs, fireball_speeds, i);
+        });
+
+        if (controls.isSpacePressed(input) && time - _last_shoot_time > FIREBALL_COOLDOWN) {
+            _last_shoot_time = time;
+            create_fireball(controls.direction);
+            events.fired = 1;
+        }
+
+        // the CPU keeps the pose only for collisions, from the same closed form the shader uses
+        targets.animate(time + dt);
+        for (size_t i = 0; i < fireballs.size(); ++i) {
+            // trail left behind along the tick's motion
+            float trail = FIREBALL_TRAIL_RATE * dt;
+            size_t count = size_t(trail) + (_random.uniform() < trail - size_t(trail));
+            ParticleEmitter emitter{fireball_speeds[i] * -0.05f, 0.4f, glm::vec3(1.0f, 0.45f, 0.1f), 0.5f};
+            particles.emit(fireballs[i].center, emitter, count);
+            fireballs[i].animate(fireball_speeds[i], time + dt);
+        }
+        particles.update(dt, _workers);
+        time += dt;
+
+        _stats.ticks += 1;
+        _stats.spawned += events.spawned;
+        _stats.expired += events.expired;
+        _stats.collisions += events.collisions;
+        _stats.fired += events.fired;
+        _stats.peak_targets = std::max(_stats.peak_targets, targets.size());
+        return events;
+    }
+
+    // Streams the world around the player: targets of cells coming into range
+    // come back to life, targets leaving it are frozen into their cells.
+    void stream() {
+        for (const auto& record : world.recenter(controls.position, _tiles)) {
+            if (record.lifetime > time) {
+                restore_target(record);
+            }
+        }
+        for (size_t i = targets.size(); i-- > 0;) {
+            if (!world.is_active(targets.center(i))) {
+                world.store(target_record(targets, i, time));
+                remove_object(target_instances, targets, i);
+            }
+        }
+        for (size_t i = fireballs.size(); i-- > 0;) {
+            if (!world.is_active(fireballs[i].center)) {
+                remove_object(fireball_instances, fireballs, fireball_speeds, i);
+            }
+        }
+    }
+};
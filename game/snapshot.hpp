@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Flat binary world snapshot.
+//
+// Layout: Header, then entity records, mesh records and mesh vertices,
+// each array 8-byte aligned and addressed by offsets from the file start.
+// All records are plain structs, so a mapped file is used in place.
+namespace Snapshot {
+
+const uint32_t MAGIC = 0x53484347;  // "GCHS"
+const uint32_t VERSION = 3;
+
+enum EntityKind : uint32_t {
+    ENTITY_TARGET = 1,
+    ENTITY_FIREBALL = 2,
+};
+
+enum MeshId : uint32_t {
+    MESH_FLOOR = 1,
+    MESH_CUBE = 2,
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t timestamp;  // simulation time, microseconds
+    uint32_t entity_count;
+    uint32_t entity_offset;
+    uint32_t mesh_count;
+    uint32_t mesh_offset;
+    uint32_t vertex_count;
+    uint32_t vertex_offset;
+};
+
+// Expiry is a double like the simulation clock, so it stays exact to the
+// tick however long the world has run.
+struct EntityRecord {
+    uint32_t kind;
+    uint32_t reserved;
+    double lifetime;  // time of expiry, seconds
+    float center[3];
+    float speed[3];
+    float angle[3];  // at the time of the snapshot
+    float spin[3];   // angle change per second
+    float radius;
+    float color[3];
+};
+
+struct MeshRecord {
+    uint32_t id;
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    float color[3];
+};
+
+// xyz, ready to be passed to glBufferData as is
+struct Vertex {
+    float position[3];
+};
+
+static_assert(std::is_trivially_copyable<Header>::value, "snapshot records must be POD");
+static_assert(std::is_trivially_copyable<EntityRecord>::value, "snapshot records must be POD");
+static_assert(std::is_trivially_copyable<MeshRecord>::value, "snapshot records must be POD");
+static_assert(sizeof(Header) == 40, "snapshot header layout changed, bump VERSION");
+static_assert(sizeof(EntityRecord) == 80, "snapshot entity layout changed, bump VERSION");
+static_assert(sizeof(MeshRecord) == 24, "snapshot mesh layout changed, bump VERSION");
+
+inline uint32_t align8(size_t offset) {
+    return uint32_t((offset + 7) & ~size_t(7));
+}
+
+
+// Read-only file mapping. Falls back to a single read where mmap is unavailable.
+class MappedFile {
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> _storage;
+#endif
+public:
+    MappedFile() {}
+
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream) {
+            return;
+        }
+        _storage.resize(size_t(stream.tellg()));
+        stream.seekg(0);
+        stream.read(reinterpret_cast<char*>(_storage.data()), _storage.size());
+        _data = _storage.data();
+        _size = _storage.size();
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                _data = static_cast<const uint8_t*>(addr);
+                _size = size_t(st.st_size);
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (_data) {
+            munmap(const_cast<uint8_t*>(_data), _size);
+        }
+#endif
+    }
+
+    const uint8_t* data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+};
+
+
+template <typename T>
+struct Span {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t i) const { return data[i]; }
+};
+
+
+// Validated view over snapshot bytes. Does not copy anything.
+class View {
+    const Header* _header = nullptr;
+    const uint8_t* _data = nullptr;
+
+    template <typename T>
+    Span<T> span(uint32_t offset, uint32_t count) const {
+        return Span<T>{reinterpret_cast<const T*>(_data + offset), count};
+    }
+
+    static bool fits(size_t size, uint32_t offset, uint32_t count, size_t record) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / record;
+    }
+public:
+    View(const uint8_t* data, size_t size) {
+        if (!data || size < sizeof(Header)) {
+            return;
+        }
+        auto header = reinterpret_cast<const Header*>(data);
+        if (header->magic != MAGIC || header->version != VERSION) {
+            return;
+        }
+        if (!fits(size, header->entity_offset, header->entity_count, sizeof(EntityRecord))
+            || !fits(size, header->mesh_offset, header->mesh_count, sizeof(MeshRecord))
+            || !fits(size, header->vertex_offset, header->vertex_count, sizeof(Vertex))) {
+            return;
+        }
+        // every mesh must lie within the vertex array
+        auto meshes = reinterpret_cast<const MeshRecord*>(data + header->mesh_offset);
+        for (uint32_t i = 0; i < header->mesh_count; ++i) {
+            if (meshes[i].first_vertex > header->vertex_count
+                || meshes[i].vertex_count > header->vertex_count - meshes[i].first_vertex) {
+                return;
+            }
+        }
+        _header = header;
+        _data = data;
+    }
+
+    explicit View(const MappedFile& file) : View(file.data(), file.size()) {}
+
+    bool valid() const {
+        return _header != nullptr;
+    }
+
+    uint64_t timestamp() const {
+        return _header->timestamp;
+    }
+
+    Span<EntityRecord> entities() const {
+        return span<EntityRecord>(_header->entity_offset, _header->entity_count);
+    }
+
+    Span<MeshRecord> meshes() const {
+        return span<MeshRecord>(_header->mesh_offset, _header->mesh_count);
+    }
+
+    Span<Vertex> vertices() const {
+        return span<Vertex>(_header->vertex_offset, _header->vertex_count);
+    }
+
+    const MeshRecord* find_mesh(uint32_t id) const {
+        for (const auto& mesh : meshes()) {
+            if (mesh.id == id) {
+                return &mesh;
+            }
+        }
+        return nullptr;
+    }
+
+    // vertices of a mesh as a flat xyz float array
+    const float* mesh_data(const MeshRecord& mesh) const {
+        return vertices()[mesh.first_vertex].position;
+    }
+};
+
+
+class Writer {
+    std::vector<EntityRecord> _entities;
+    std::vector<MeshRecord> _meshes;
+    std::vector<Vertex> _vertices;
+public:
+    void add_entity(const EntityRecord& entity) {
+        _entities.push_back(entity);
+    }
+
+    void add_mesh(uint32_t id, const float* vertices, size_t vertex_count, const float* color) {
+        MeshRecord mesh{id, uint32_t(_vertices.size()), uint32_t(vertex_count), {color[0], color[1], color[2]}};
+        _meshes.push_back(mesh);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            _vertices.push_back(Vertex{{vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]}});
+        }
+    }
+
+    std::vector<uint8_t> serialize(uint64_t timestamp) const {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.timestamp = timestamp;
+        header.entity_count = uint32_t(_entities.size());
+        header.entity_offset = align8(sizeof(Header));
+        header.mesh_count = uint32_t(_meshes.size());
+        header.mesh_offset = align8(header.entity_offset + sizeof(EntityRecord) * _entities.size());
+        header.vertex_count = uint32_t(_vertices.size());
+        header.vertex_offset = align8(header.mesh_offset + sizeof(MeshRecord) * _meshes.size());
+
+        std::vector<uint8_t> bytes(header.vertex_offset + sizeof(Vertex) * _vertices.size(), 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        if (!_entities.empty()) {
+            std::memcpy(bytes.data() + header.entity_offset, _entities.data(), sizeof(EntityRecord) * _entities.size());
+        }
+        if (!_meshes.empty()) {
+            std::memcpy(bytes.data() + header.mesh_offset, _meshes.data(), sizeof(MeshRecord) * _meshes.size());
+        }
+        if (!_vertices.empty()) {
+            std::memcpy(bytes.data() + header.vertex_offset, _vertices.data(), sizeof(Vertex) * _vertices.size());
+        }
+        return bytes;
+    }
+
+    bool write(const std::string& path, uint64_t timestamp) const {
+        std::vector<uint8_t> bytes = serialize(timestamp);
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return fclose(file) == 0 && ok;
+    }
+};
+
+}  // namespace Snapshot
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+#include "random.hpp"
+
+// Targets about to spawn, as structure of arrays. The live targets keep
+// their spawn state in one of these too, see Targets.
+struct TargetBatch {
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+    std::vector<float> angle_x, angle_y, angle_z;
+    std::vector<float> r, g, b;
+    std::vector<float> speed_x, speed_y, speed_z;
+    std::vector<float> spin_x, spin_y, spin_z;
+    std::vector<double> lifetime;  // time of expiry, seconds
+
+    static constexpr size_t FLOAT_COLUMNS = 16;
+
+    std::array<std::vector<float>*, FLOAT_COLUMNS> float_columns() {
+        return {&x, &y, &z, &radius, &angle_x, &angle_y, &angle_z, &r, &g, &b,
+            &speed_x, &speed_y, &speed_z, &spin_x, &spin_y, &spin_z};
+    }
+
+    std::array<const std::vector<float>*, FLOAT_COLUMNS> float_columns() const {
+        return {&x, &y, &z, &radius, &angle_x, &angle_y, &angle_z, &r, &g, &b,
+            &speed_x, &speed_y, &speed_z, &spin_x, &spin_y, &spin_z};
+    }
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void resize(size_t count) {
+        for (auto* column : float_columns()) {
+            column->resize(count);
+        }
+        lifetime.resize(count);
+    }
+
+    // every target of other at the end, one bulk copy per column
+    void append(const TargetBatch& other) {
+        auto to = float_columns();
+        auto from = other.float_columns();
+        for (size_t k = 0; k < FLOAT_COLUMNS; ++k) {
+            to[k]->insert(to[k]->end(), from[k]->begin(), from[k]->end());
+        }
+        lifetime.insert(lifetime.end(), other.lifetime.begin(), other.lifetime.end());
+    }
+
+    // the last target takes the place of target i
+    void remove(size_t i) {
+        for (auto* column : float_columns()) {
+            (*column)[i] = column->back();
+            column->pop_back();
+        }
+        lifetime[i] = lifetime.back();
+        lifetime.pop_back();
+    }
+};
+
+
+// Generates targets in bulk, in parallel chunks of a WorkerPool.
+//
+// Every target draws its 16 numbers from four Philox blocks keyed by the seed
+// and counted by the target's serial number, so a wave comes out the same
+// whatever the number of threads or the chunking.
+class TargetSpawner {
+public:
+    struct Settings {
+        float ring = 5.0f;          // distance around the center spawns are placed at
+        float min_height = 0.1f;
+        float max_height = 3.1f;
+        float min_radius = 0.1f;
+        float max_radius = 0.15f;
+        float max_speed = 0.6f;     // per axis, units per second
+        float max_spin = 2.0f;      // per axis, radians per second
+        float lifetime_per_brightness = 16.0f;  // seconds per unit of r + g + b
+    };
+
+private:
+    Settings _settings;
+    Random::Philox _philox;
+    uint64_t _spawned = 0;  // serial number of the next target
+
+public:
+    // targets per parallel chunk
+    static constexpr size_t GRAIN = 2048;
+
+    explicit TargetSpawner(const Settings& settings, uint64_t seed=0) : _settings(settings), _philox(seed) {}
+
+    uint64_t spawned() const {
+        return _spawned;
+    }
+
+    // Replaces batch with count new targets around center, spawning at time.
+    void generate(size_t count, double time, const glm::vec3& center, TargetBatch& batch, WorkerPool& pool) {
+        batch.resize(count);
+        const uint64_t first = _spawned;
+        _spawned += count;
+        const Settings s = _settings;
+        const Random::Philox philox = _philox;
+        pool.parallel_for(count, GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                uint64_t serial = first + i;
+                uint32_t lo = uint32_t(serial);
+                uint32_t hi = uint32_t(serial >> 32);
+                const uint32_t purpose = uint32_t(Random::Purpose::TARGETS);
+                auto w0 = philox(lo, hi, 0, purpose);
+                auto w1 = philox(lo, hi, 1, purpose);
+                auto w2 = philox(lo, hi, 2, purpose);
+                auto w3 = philox(lo, hi, 3, purpose);
+
+                float around = Random::unit(w0[0]) * 6.2831853f;
+                batch.x[i] = center.x + s.ring * std::sin(around);
+                batch.y[i] = s.min_height + (s.max_height - s.min_height) * Random::unit(w0[1]);
+                batch.z[i] = center.z + s.ring * std::cos(around);
+                batch.radius[i] = s.min_radius + (s.max_radius - s.min_radius) * Random::unit(w0[2]);
+                batch.angle_x[i] = Random::unit(w0[3]) * 3.1415927f;
+                batch.angle_y[i] = Random::unit(w1[0]) * 3.1415927f;
+                batch.angle_z[i] = Random::unit(w1[1]) * 3.1415927f;
+                batch.r[i] = Random::unit(w1[2]);
+                batch.g[i] = Random::unit(w1[3]);
+                batch.b[i] = Random::unit(w2[0]);
+                batch.speed_x[i] = Random::unit(w2[1]) * s.max_speed;
+                batch.speed_y[i] = Random::unit(w2[2]) * s.max_speed;
+                batch.speed_z[i] = Random::unit(w2[3]) * s.max_speed;
+                batch.spin_x[i] = (2 * Random::unit(w3[0]) - 1) * s.max_spin;
+                batch.spin_y[i] = (2 * Random::unit(w3[1]) - 1) * s.max_spin;
+                batch.spin_z[i] = (2 * Random::unit(w3[2]) - 1) * s.max_spin;
+                // brighter targets live longer
+                batch.lifetime[i] = time + (batch.r[i] + batch.g[i] + batch.b[i]) * s.lifetime_per_brightness;
+            }
+        });
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "objects.hpp"
+#include "collision.hpp"
+#include "spawner.hpp"
+
+// Live targets as structure of arrays.
+//
+// The spawn state sits in the columns of a TargetBatch: position and angle at
+// spawn, radius, color, speed, spin and time of expiry. A generated batch is
+// appended with one bulk copy per column. Targets move and spin at a constant
+// rate from their spawn time, in the same closed form the instanced shader
+// evaluates. The centers are kept up to date by animate() for collisions and
+// streaming, and the angles are computed when a box is needed. Removal moves
+// the last target into the hole, as with the instances.
+class Targets {
+    TargetBatch _spawn;
+    std::vector<double> _spawn_time;
+    std::vector<float> _x, _y, _z;  // centers as of the last animate()
+
+public:
+    size_t size() const {
+        return _x.size();
+    }
+
+    bool empty() const {
+        return _x.empty();
+    }
+
+    // batch spawns at time, where it was generated
+    void append(const TargetBatch& batch, double time) {
+        _spawn.append(batch);
+        _spawn_time.insert(_spawn_time.end(), batch.size(), time);
+        _x.insert(_x.end(), batch.x.begin(), batch.x.end());
+        _y.insert(_y.end(), batch.y.begin(), batch.y.end());
+        _z.insert(_z.end(), batch.z.begin(), batch.z.end());
+    }
+
+    // one target spawning at time from center, turned by angle
+    void add(const glm::vec3& center, float radius, const glm::vec3& angle, const glm::vec3& spin,
+        const glm::vec3& speed, const glm::vec3& color, double lifetime, double time) {
+        const float values[TargetBatch::FLOAT_COLUMNS] = {center.x, center.y, center.z, radius,
+            angle.x, angle.y, angle.z, color.x, color.y, color.z,
+            speed.x, speed.y, speed.z, spin.x, spin.y, spin.z};
+        auto columns = _spawn.float_columns();
+        for (size_t k = 0; k < TargetBatch::FLOAT_COLUMNS; ++k) {
+            columns[k]->push_back(values[k]);
+        }
+        _spawn.lifetime.push_back(lifetime);
+        _spawn_time.push_back(time);
+        _x.push_back(center.x);
+        _y.push_back(center.y);
+        _z.push_back(center.z);
+    }
+
+    void remove(size_t i) {
+        _spawn.remove(i);
+        _spawn_time[i] = _spawn_time.back();
+        _spawn_time.pop_back();
+        _x[i] = _x.back();
+        _x.pop_back();
+        _y[i] = _y.back();
+        _y.pop_back();
+        _z[i] = _z.back();
+        _z.pop_back();
+    }
+
+    // moves the centers to where they are at time
+    void animate(double time) {
+        const TargetBatch& s = _spawn;
+        for (size_t i = 0; i < size(); ++i) {
+            float age = float(time - _spawn_time[i]);
+            _x[i] = s.x[i] + s.speed_x[i] * age;
+            _y[i] = s.y[i] + s.speed_y[i] * age;
+            _z[i] = s.z[i] + s.speed_z[i] * age;
+        }
+    }
+
+    glm::vec3 center(size_t i) const {
+        return glm::vec3(_x[i], _y[i], _z[i]);
+    }
+
+    glm::vec3 spawn_center(size_t i) const {
+        return glm::vec3(_spawn.x[i], _spawn.y[i], _spawn.z[i]);
+    }
+
+    double spawn_time(size_t i) const {
+        return _spawn_time[i];
+    }
+
+    glm::vec3 spawn_angle(size_t i) const {
+        return glm::vec3(_spawn.angle_x[i], _spawn.angle_y[i], _spawn.angle_z[i]);
+    }
+
+    glm::vec3 angle(size_t i, double time) const {
+        return spawn_angle(i) + spin(i) * float(time - _spawn_time[i]);
+    }
+
+    glm::vec3 spin(size_t i) const {
+        return glm::vec3(_spawn.spin_x[i], _spawn.spin_y[i], _spawn.spin_z[i]);
+    }
+
+    glm::vec3 speed(size_t i) const {
+        return glm::vec3(_spawn.speed_x[i], _spawn.speed_y[i], _spawn.speed_z[i]);
+    }
+
+    glm::vec3 color(size_t i) const {
+        return glm::vec3(_spawn.r[i], _spawn.g[i], _spawn.b[i]);
+    }
+
+    float radius(size_t i) const {
+        return _spawn.radius[i];
+    }
+
+    // time of expiry, seconds
+    double lifetime(size_t i) const {
+        return _spawn.lifetime[i];
+    }
+
+    bool expired(size_t i, double time) const {
+        return time >= _spawn.lifetime[i];
+    }
+
+    // radius of the sphere around the rotated cube
+    float bounding_radius(size_t i) const {
+        return _spawn.radius[i] * std::sqrt(3.0f);
+    }
+
+    // the cube spans [-1, 1] before being stretched by radius and turned by the angle at time
+    Collision::Obb obb(size_t i, double time) const {
+        glm::vec3 turn = angle(i, time);
+        Collision::Obb box;
+        box.center = center(i);
+        box.axes[0] = Triangle::rotate(glm::vec3(1, 0, 0), turn);
+        box.axes[1] = Triangle::rotate(glm::vec3(0, 1, 0), turn);
+        box.axes[2] = Triangle::rotate(glm::vec3(0, 0, 1), turn);
+        box.half = glm::vec3(radius(i), radius(i), radius(i));
+        return box;
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// Monotonic high resolution time in seconds since construction.
+class Clock {
+    using clock = std::chrono::steady_clock;
+    clock::time_point _start = clock::now();
+public:
+    double now() const {
+        return std::chrono::duration<double>(clock::now() - _start).count();
+    }
+};
+
+
+// Counters over a reporting period, reset by the reader.
+struct TimingStats {
+    size_t frames = 0;
+    size_t ticks = 0;
+    size_t dropped_ticks = 0;
+    double frame_time = 0;  // sum, seconds
+    double max_frame_time = 0;
+    double sleep_time = 0;  // spent waiting in the pacer, seconds
+    double tick_rate = 0;   // ticks per second at the end of the period
+
+    double average_frame_ms() const {
+        return frames ? 1000 * frame_time / frames : 0;
+    }
+};
+
+
+// Every frame time of a run, summarized at the end of benchmark runs.
+// Reserve the frame count up front so adding never reallocates.
+class FrameTimes {
+    std::vector<double> _times;
+    mutable std::vector<double> _sorted;  // _times in order, rebuilt by percentile() after an add()
+public:
+    void reserve(size_t frames) {
+        _times.reserve(frames);
+    }
+
+    void add(double frame_time) {
+        _times.push_back(frame_time);
+    }
+
+    size_t size() const {
+        return _times.size();
+    }
+
+    double total() const {
+        double sum = 0;
+        for (double time : _times) {
+            sum += time;
+        }
+        return sum;
+    }
+
+    // p in [0, 1], nearest rank
+    double percentile(double p) const {
+        if (_times.empty()) {
+            return 0;
+        }
+        if (_sorted.size() != _times.size()) {
+            _sorted = _times;
+            std::sort(_sorted.begin(), _sorted.end());
+        }
+        return _sorted[std::min(size_t(p * _sorted.size()), _sorted.size() - 1)];
+    }
+};
+
+
+// Sleeps the remainder of each frame when rendering is faster than the target rate.
+// Sleeping is coarse, so the last couple of milliseconds are spun.
+class FramePacer {
+    double _frame_time;  // 0 disables pacing
+    double _next = 0;
+public:
+    explicit FramePacer(double fps) : _frame_time(fps > 0 ? 1.0 / fps : 0) {}
+
+    // Returns time spent waiting. idle() is called about every millisecond while waiting.
+    template <typename Idle>
+    double wait(const Clock& clock, Idle idle) {
+        if (_frame_time == 0) {
+            return 0;
+        }
+        double start = clock.now();
+        if (_next == 0 || start - _next > _frame_time) {
+            // first frame or too far behind: do not try to catch up
+            _next = start + _frame_time;
+            return 0;
+        }
+        const double slice = 0.001;
+        while (_next - clock.now() > 2 * slice) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(slice));
+            idle();
+        }
+        while (clock.now() < _next) {
+            std::this_thread::yield();
+        }
+        _next += _frame_time;
+        return clock.now() - start;
+    }
+
+    double wait(const Clock& clock) {
+        return wait(clock, [] {});
+    }
+};
+
+
+// Fixed simulation step driven by real frame time.
+// At most max_substeps ticks run per frame, the rest is dropped, so an overloaded
+// frame slows the game down instead of spiralling. While ticks are dropped the
+// tick grows up to max_tick (collisions are swept, so coarser ticks stay correct);
+// with headroom it shrinks back to the base tick.
+class Timestep {
+    double _base_tick;
+    double _max_tick;
+    double _tick;
+    size_t _max_substeps;
+    double _accumulator = 0;
+    double _calm = 0;  // time since ticks were last dropped
+public:
+    Timestep(double rate, double min_rate, size_t max_substeps)
+        : _base_tick(1.0 / rate), _max_tick(1.0 / min_rate), _tick(1.0 / rate), _max_substeps(max_substeps) {}
+
+    double tick() const {
+        return _tick;
+    }
+
+    // number of ticks to simulate for a frame that took frame_time
+    size_t advance(double frame_time, TimingStats& stats) {
+        _accumulator += frame_time;
+        size_t ticks = size_t(_accumulator / _tick);
+        size_t dropped = 0;
+        if (ticks > _max_substeps) {
+            dropped = ticks - _max_substeps;
+            ticks = _max_substeps;
+        }
+        _accumulator -= (ticks + dropped) * _tick;
+
+        if (dropped > 0) {
+            _calm = 0;
+            _tick = std::min(_tick * 1.25, _max_tick);
+        } else {
+            _calm += frame_time;
+            if (_calm > 2.0 && _tick > _base_tick) {
+                _calm = 0;
+                _tick = std::max(_tick / 1.25, _base_tick);
+            }
+        }
+
+        stats.ticks += ticks;
+        stats.dropped_ticks += dropped;
+        stats.tick_rate = 1.0 / _tick;
+        return ticks;
+    }
+};
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "../baked_mesh.hpp"
+
+namespace MeshOptimize {
+
+struct VertexHash {
+    size_t operator()(const BakedMesh::Vertex& v) const {
+        const auto bytes = reinterpret_cast<const uint32_t*>(&v);
+        size_t hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(v) / sizeof(uint32_t); ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const BakedMesh::Vertex& lhs, const BakedMesh::Vertex& rhs) const {
+        return std::memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+    }
+};
+
+
+// Merges bit-identical vertices, rewriting indices to point at the unique copies.
+inline void deduplicate(std::vector<BakedMesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::unordered_map<BakedMesh::Vertex, uint32_t, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    std::vector<BakedMesh::Vertex> result;
+    std::vector<uint32_t> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto inserted = unique.emplace(vertices[i], uint32_t(result.size()));
+        if (inserted.second) {
+            result.push_back(vertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+    for (auto& index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO cache.
+inline float acmr(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size=16) {
+    if (indices.empty()) {
+        return 0;
+    }
+    std::vector<size_t> stamp(vertex_count, 0);
+    size_t time = cache_size + 1;
+    size_t misses = 0;
+    for (auto index : indices) {
+        if (time - stamp[index] > cache_size) {
+            stamp[index] = time++;
+            ++misses;
+        }
+    }
+    return float(misses) / (indices.size() / 3);
+}
+
+
+// Tom Forsyth's linear-speed vertex cache optimisation.
+// Greedily emits the triangle whose vertices score best: recently used
+// vertices and vertices with few remaining triangles are preferred.
+class Forsyth {
+    static const int CACHE_SIZE = 32;
+    static constexpr float CACHE_DECAY_POWER = 1.5f;
+    static constexpr float LAST_TRI_SCORE = 0.75f;
+    static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    struct VertexData {
+        int cache_position = -1;
+        float score = 0;
+        uint32_t remaining = 0;
+        uint32_t first_triangle = 0;  // offset into the adjacency array
+    };
+
+    static float score(const VertexData& vertex) {
+        if (vertex.remaining == 0) {
+            return -1.0f;
+        }
+        float result = 0;
+        if (vertex.cache_position >= 0) {
+            if (vertex.cache_position < 3) {
+                result = LAST_TRI_SCORE;
+            } else {
+                const float scaler = 1.0f / (CACHE_SIZE - 3);
+                result = std::pow(1.0f - (vertex.cache_position - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        result += VALENCE_BOOST_SCALE * std::pow(float(vertex.remaining), -VALENCE_BOOST_POWER);
+        return result;
+    }
+
+public:
+    static std::vector<uint32_t> optimize(const std::vector<uint32_t>& indices, size_t vertex_count) {
+        const size_t triangle_count = indices.size() / 3;
+        std::vector<VertexData> vertices(vertex_count);
+        for (auto index : indices) {
+            ++vertices[index].remaining;
+        }
+        uint32_t offset = 0;
+        for (auto& vertex : vertices) {
+            vertex.first_triangle = offset;
+            offset += vertex.remaining;
+        }
+
+        // vertex -> triangles that use it, only the live prefix of each list is kept
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> filled(vertex_count, 0);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            for (size_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[3 * t + k];
+                adjacency[vertices[v].first_triangle + filled[v]++] = uint32_t(t);
+            }
+        }
+
+        for (auto& vertex : vertices) {
+            vertex.score = score(vertex);
+        }
+        std::vector<float> triangle_score(triangle_count);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            triangle_score[t] = vertices[indices[3 * t]].score
+                + vertices[indices[3 * t + 1]].score
+                + vertices[indices[3 * t + 2]].score;
+        }
+
+        std::vector<bool> emitted(triangle_count, false);
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache;
+        cache.reserve(CACHE_SIZE + 3);
+
+        size_t scan = 0;  // lowest triangle that might not be emitted yet
+        int64_t best = -1;
+        for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+            if (best < 0) {
+                float best_score = -1;
+                for (size_t t = scan; t < triangle_count; ++t) {
+                    if (!emitted[t] && triangle_score[t] > best_score) {
+                        best_score = triangle_score[t];
+                        best = int64_t(t);
+                    }
+                }
+            }
+
+            const uint32_t tri = uint32_t(best);
+            emitted[tri] = true;
+            while (scan < triangle_count && emitted[scan]) {
+                ++scan;
+            }
+
+            // emit and remove the triangle from its vertices' adjacency
+            std::vector<uint32_t> new_cache;
+            new_cache.reserve(CACHE_SIZE + 3);
+            for (size_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[3 * tri + k];
+                result.push_back(v);
+                new_cache.push_back(v);
+                VertexData& vertex = vertices[v];
+                uint32_t* list = adjacency.data() + vertex.first_triangle;
+                for (uint32_t i = 0; i < vertex.remaining; ++i) {
+                    if (list[i] == tri) {
+                        std::swap(list[i], list[vertex.remaining - 1]);
+                        break;
+                    }
+                }
+                --vertex.remaining;
+            }
+            for (auto v : cache) {
+                if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) {
+                    new_cache.push_back(v);
+                }
+            }
+
+            // rescore everything that was in the cache, including evicted vertices
+            for (size_t i = 0; i < new_cache.size(); ++i) {
+                vertices[new_cache[i]].cache_position = i < CACHE_SIZE ? int(i) : -1;
+            }
+            best = -1;
+            float best_score = -1;
+            for (auto v : new_cache) {
+                VertexData& vertex = vertices[v];
+                float delta = score(vertex) - vertex.score;
+                vertex.score += delta;
+                const uint32_t* list = adjacency.data() + vertex.first_triangle;
+                for (uint32_t i = 0; i < vertex.remaining; ++i) {
+                    triangle_score[list[i]] += delta;
+                }
+            }
+            for (size_t i = 0; i < new_cache.size() && i < CACHE_SIZE; ++i) {
+                const VertexData& vertex = vertices[new_cache[i]];
+                const uint32_t* list = adjacency.data() + vertex.first_triangle;
+                for (uint32_t j = 0; j < vertex.remaining; ++j) {
+                    if (triangle_score[list[j]] > best_score) {
+                        best_score = triangle_score[list[j]];
+                        best = int64_t(list[j]);
+                    }
+                }
+            }
+            if (new_cache.size() > CACHE_SIZE) {
+                new_cache.resize(CACHE_SIZE);
+            }
+            cache.swap(new_cache);
+        }
+        return result;
+    }
+};
+
+
+// Renumbers vertices in first-use order so vertex fetch follows the index stream.
+inline void reorder_vertices(std::vector<BakedMesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<BakedMesh::Vertex> result;
+    result.reserve(vertices.size());
+    for (auto& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = uint32_t(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+
+// Makes triangles wind counter-clockwise seen from outside, see winding.hpp.
+// Vertices of flipped triangles get smooth normals recomputed from the fixed faces.
+inline Winding::Report orient(std::vector<BakedMesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        positions.emplace_back(vertex.position[0], vertex.position[1], vertex.position[2]);
+    }
+    std::vector<uint8_t> flipped;
+    Winding::Report report = Winding::orient(positions, indices, &flipped);
+    if (report.flipped == 0) {
+        return report;
+    }
+
+    std::vector<uint8_t> stale(vertices.size(), 0);
+    for (size_t t = 0; t < flipped.size(); ++t) {
+        if (flipped[t]) {
+            stale[indices[3 * t]] = stale[indices[3 * t + 1]] = stale[indices[3 * t + 2]] = 1;
+        }
+    }
+    // area weighted, the cross product is twice the area
+    std::vector<glm::vec3> normals(vertices.size(), glm::vec3(0, 0, 0));
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const glm::vec3& a = positions[indices[i]];
+        glm::vec3 face = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+        for (size_t k = 0; k < 3; ++k) {
+            normals[indices[i + k]] += face;
+        }
+    }
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        float length = glm::length(normals[v]);
+        if (stale[v] && length > 0) {
+            glm::vec3 normal = normals[v] / length;
+            vertices[v].normal[0] = normal.x;
+            vertices[v].normal[1] = normal.y;
+            vertices[v].normal[2] = normal.z;
+        }
+    }
+    return report;
+}
+
+
+// Ritter's bounding sphere: not minimal, but within a few percent and linear time.
+inline void bounding_sphere(const std::vector<BakedMesh::Vertex>& vertices, float center[3], float& radius) {
+    center[0] = center[1] = center[2] = 0;
+    radius = 0;
+    if (vertices.empty()) {
+        return;
+    }
+    auto position = [&](size_t i) {
+        const float* p = vertices[i].position;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    auto farthest = [&](const glm::vec3& from) {
+        size_t best = 0;
+        float best_distance = -1;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            float d = glm::distance(from, position(i));
+            if (d > best_distance) {
+                best_distance = d;
+                best = i;
+            }
+        }
+        return position(best);
+    };
+
+    glm::vec3 a = farthest(position(0));
+    glm::vec3 b = farthest(a);
+    glm::vec3 c = (a + b) * 0.5f;
+    float r = glm::distance(a, b) * 0.5f;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        glm::vec3 p = position(i);
+        float d = glm::distance(p, c);
+        if (d > r) {
+            float new_r = (r + d) * 0.5f;
+            c += (p - c) * ((new_r - r) / d);
+            r = new_r;
+        }
+    }
+    center[0] = c.x;
+    center[1] = c.y;
+    center[2] = c.z;
+    radius = r;
+}
+
+}  // namespace MeshOptimize
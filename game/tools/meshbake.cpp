@@ -0,0 +1,129 @@
+// Offline mesh baker: imports OBJ/PLY through assimp and writes a BakedMesh file
+// with deduplicated, cache-optimized, indexed geometry and a bounding sphere.
+//
+// usage: meshbake <input.obj|input.ply> <output.mesh>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "mesh_optimize.hpp"
+
+
+bool import_mesh(const char* path, std::vector<BakedMesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+    Assimp::Importer importer;
+    // no JoinIdenticalVertices / ImproveCacheLocality: that is done below
+    const aiScene* scene = importer.ReadFile(path,
+        aiProcess_Triangulate
+        | aiProcess_PreTransformVertices
+        | aiProcess_GenSmoothNormals
+        | aiProcess_SortByPType);
+    if (!scene) {
+        fprintf(stderr, "Failed to import %s: %s\n", path, importer.GetErrorString());
+        return false;
+    }
+
+    for (unsigned m = 0; m < scene->mNumMeshes; ++m) {
+        const aiMesh* mesh = scene->mMeshes[m];
+        if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE)) {
+            continue;
+        }
+        const uint32_t base = uint32_t(vertices.size());
+        for (unsigned i = 0; i < mesh->mNumVertices; ++i) {
+            BakedMesh::Vertex vertex;
+            std::memset(&vertex, 0, sizeof(vertex));
+            const aiVector3D& p = mesh->mVertices[i];
+            vertex.position[0] = p.x;
+            vertex.position[1] = p.y;
+            vertex.position[2] = p.z;
+            if (mesh->HasNormals()) {
+                const aiVector3D& n = mesh->mNormals[i];
+                vertex.normal[0] = n.x;
+                vertex.normal[1] = n.y;
+                vertex.normal[2] = n.z;
+            }
+            if (mesh->HasTextureCoords(0)) {
+                const aiVector3D& uv = mesh->mTextureCoords[0][i];
+                vertex.uv[0] = uv.x;
+                vertex.uv[1] = uv.y;
+            }
+            vertices.push_back(vertex);
+        }
+        for (unsigned f = 0; f < mesh->mNumFaces; ++f) {
+            const aiFace& face = mesh->mFaces[f];
+            if (face.mNumIndices != 3) {
+                continue;
+            }
+            for (unsigned k = 0; k < 3; ++k) {
+                indices.push_back(base + face.mIndices[k]);
+            }
+        }
+    }
+    return !indices.empty();
+}
+
+
+bool write_mesh(const char* path, const std::vector<BakedMesh::Vertex>& vertices,
+    const std::vector<uint32_t>& indices, const float center[3], float radius) {
+    BakedMesh::Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = BakedMesh::MAGIC;
+    header.version = BakedMesh::VERSION;
+    header.vertex_count = uint32_t(vertices.size());
+    header.vertex_offset = Snapshot::align8(sizeof(header));
+    header.index_count = uint32_t(indices.size());
+    header.index_offset = Snapshot::align8(header.vertex_offset + sizeof(BakedMesh::Vertex) * vertices.size());
+    std::memcpy(header.center, center, sizeof(header.center));
+    header.radius = radius;
+
+    std::vector<uint8_t> bytes(header.index_offset + sizeof(uint32_t) * indices.size(), 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + header.vertex_offset, vertices.data(), sizeof(BakedMesh::Vertex) * vertices.size());
+    std::memcpy(bytes.data() + header.index_offset, indices.data(), sizeof(uint32_t) * indices.size());
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <input.obj|input.ply> <output.mesh>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<BakedMesh::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    if (!import_mesh(argv[1], vertices, indices)) {
+        return 1;
+    }
+    size_t imported = vertices.size();
+
+    // the game culls back faces, so every triangle has to face outward
+    Winding::Report winding = MeshOptimize::orient(vertices, indices);
+    MeshOptimize::deduplicate(vertices, indices);
+    float acmr_before = MeshOptimize::acmr(indices, vertices.size());
+    indices = MeshOptimize::Forsyth::optimize(indices, vertices.size());
+    MeshOptimize::reorder_vertices(vertices, indices);
+    float acmr_after = MeshOptimize::acmr(indices, vertices.size());
+
+    float center[3];
+    float radius;
+    MeshOptimize::bounding_sphere(vertices, center, radius);
+
+    if (!write_mesh(argv[2], vertices, indices, center, radius)) {
+        return 1;
+    }
+    printf("%s: %zu triangles (%zu flipped), %zu -> %zu vertices, ACMR %.3f -> %.3f, bounding sphere r=%.3f\n",
+        argv[2], indices.size() / 3, winding.flipped, imported, vertices.size(), acmr_before, acmr_after, radius);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#!/bin/sh
+# Builds the game three ways and benchmarks them on the same workload:
+#   plain    no optimization flags, as the build was before build types were set
+#   release  Release with link time optimization
+#   pgo      release, then rebuilt from profiles of an instrumented run of the workload
+# The workload is a rendered headless run and a batch of worlds, both with
+# scripted input and a fixed seed, so every run replays the same game.
+#
+#   tools/pgo_build.sh [build root]   (default ../build-pgo next to the game directory)
+#
+# Writes report.md in the build root. RUNS sets the runs per measurement (3).
+# Numbers are read from the RESULT lines the game prints, see Log::result.
+set -e
+
+GAME_DIR=$(cd "$(dirname "$0")/.." && pwd)
+ROOT=${1:-$GAME_DIR/../build-pgo}
+mkdir -p "$ROOT"
+ROOT=$(cd "$ROOT" && pwd)
+RUNS=${RUNS:-3}
+JOBS=$(nproc 2>/dev/null || echo 4)
+PROFILES="$ROOT/pgo/profiles"
+
+render_workload() {
+    (cd "$GAME_DIR" && "$1" --headless --size 1280x720 --frames 1800 --autopilot --seed 1 --wave 2000 --wave-interval 5)
+}
+
+batch_workload() {
+    (cd "$GAME_DIR" && "$1" --worlds 16 --batch-ticks 1800 --seed 1 --wave 500)
+}
+
+build() {
+    dir=$1
+    shift
+    mkdir -p "$dir"
+    (cd "$dir" && cmake "$@" "$GAME_DIR") > /dev/null
+    cmake --build "$dir" --target game -- -j"$JOBS" > /dev/null
+}
+
+# value of key in the "RESULT <name> key=value ..." line of the output on stdin
+result() {
+    awk -v name="$1" -v key="$2" '$1 == "RESULT" && $2 == name {
+        for (i = 3; i <= NF; ++i) if (index($i, key "=") == 1) print substr($i, length(key) + 2) }'
+}
+
+# median of the numbers on stdin
+median() {
+    sort -n | awk '{ v[NR] = $1 } END { if (NR) print (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+# "fps p99 ticks_per_second" of a binary, medians over RUNS runs
+measure() {
+    : > "$ROOT/fps" ; : > "$ROOT/p99" ; : > "$ROOT/ticks"
+    run=0
+    while [ $run -lt "$RUNS" ]; do
+        render_workload "$1" > "$ROOT/out" 2>&1
+        result render fps < "$ROOT/out" >> "$ROOT/fps"
+        result render p99_ms < "$ROOT/out" >> "$ROOT/p99"
+        batch_workload "$1" > "$ROOT/out" 2>&1
+        result batch ticks_per_second < "$ROOT/out" >> "$ROOT/ticks"
+        run=$((run + 1))
+    done
+    echo "$(median < "$ROOT/fps") $(median < "$ROOT/p99") $(median < "$ROOT/ticks")"
+    rm -f "$ROOT/fps" "$ROOT/p99" "$ROOT/ticks" "$ROOT/out"
+}
+
+echo "building plain and release"
+build "$ROOT/plain" -DCMAKE_BUILD_TYPE=None -DGOCHI_LTO=OFF
+build "$ROOT/release" -DCMAKE_BUILD_TYPE=Release
+
+echo "building instrumented, profiling"
+rm -rf "$PROFILES"
+build "$ROOT/pgo" -DCMAKE_BUILD_TYPE=Release -DGOCHI_PGO=GENERATE -DGOCHI_PGO_DIR="$PROFILES"
+render_workload "$ROOT/pgo/game" > /dev/null 2>&1
+batch_workload "$ROOT/pgo/game" > /dev/null 2>&1
+if ls "$PROFILES"/*.profraw > /dev/null 2>&1; then
+    llvm-profdata merge -o "$PROFILES/game.profdata" "$PROFILES"/*.profraw
+fi
+
+echo "rebuilding from profiles"
+build "$ROOT/pgo" -DGOCHI_PGO=USE
+
+echo "benchmarking, $RUNS runs each"
+PLAIN=$(measure "$ROOT/plain/game")
+RELEASE=$(measure "$ROOT/release/game")
+PGO=$(measure "$ROOT/pgo/game")
+
+{
+    echo "# Build benchmark"
+    echo
+    echo "$(uname -sm), $(${CXX:-c++} --version | head -n 1), medians of $RUNS runs."
+    echo "Rendered: 1800 frames at 1280x720 with --autopilot. Batch: 16 worlds of 1800 ticks."
+    echo
+    echo "| build | render fps | render p99 ms | batch ticks/s |"
+    echo "|---|---|---|---|"
+    echo "$PLAIN" | awk '{ printf "| plain | %s | %s | %s |\n", $1, $2, $3 }'
+    echo "$RELEASE" | awk '{ printf "| release + LTO | %s | %s | %s |\n", $1, $2, $3 }'
+    echo "$PGO" | awk '{ printf "| release + LTO + PGO | %s | %s | %s |\n", $1, $2, $3 }'
+    echo
+    echo "$RELEASE $PGO" | awk '{ printf "PGO over release: render fps %+.1f%%, batch ticks/s %+.1f%%\n", 100 * ($4 / $1 - 1), 100 * ($6 / $3 - 1) }'
+} > "$ROOT/report.md"
+cat "$ROOT/report.md"
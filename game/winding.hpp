@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Triangle winding validation and repair.
+//
+// Back-face culling needs every triangle counter-clockwise seen from outside.
+// Corners at the same position are welded, so seams in texture coordinates or
+// normals do not split a surface. Orientation is propagated across edges shared
+// by exactly two triangles, then each connected piece is settled as a whole:
+// a closed piece faces outward, judged by its signed volume, and an open one
+// keeps the orientation most of its triangles already had. Degenerate
+// triangles take no part.
+namespace Winding {
+
+struct Report {
+    size_t triangles = 0;
+    size_t flipped = 0;
+    size_t pieces = 0;
+    size_t open_pieces = 0;
+};
+
+
+namespace detail {
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        // adding zero turns -0 into 0, which compares equal
+        const float values[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+        uint32_t bits[3];
+        std::memcpy(bits, values, sizeof(bits));
+        return (size_t(bits[0]) * 73856093u) ^ (size_t(bits[1]) * 19349663u) ^ (size_t(bits[2]) * 83492791u);
+    }
+};
+
+inline uint64_t edge_key(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+}  // namespace detail
+
+
+// Reorients triangles given as 3 indices into positions. Flipped triangles
+// have their last two indices swapped and are marked in flipped when given.
+inline Report orient(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices,
+    std::vector<uint8_t>* flipped=nullptr) {
+    const size_t count = indices.size() / 3;
+    Report report;
+    report.triangles = count;
+
+    // one id per distinct position
+    std::unordered_map<glm::vec3, uint32_t, detail::PositionHash> ids;
+    std::vector<uint32_t> weld(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        weld[i] = ids.emplace(positions[i], uint32_t(ids.size())).first->second;
+    }
+    auto corner = [&](size_t triangle, size_t k) {
+        return weld[indices[3 * triangle + k]];
+    };
+
+    // triangles on each edge, with the direction they walk it in
+    struct Use {
+        uint32_t triangle;
+        bool forward;  // from the lower to the higher id
+    };
+    std::unordered_map<uint64_t, std::vector<Use>> edges;
+    std::vector<uint8_t> degenerate(count, 0);
+    for (size_t t = 0; t < count; ++t) {
+        uint32_t c[3] = {corner(t, 0), corner(t, 1), corner(t, 2)};
+        if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0]) {
+            degenerate[t] = 1;
+            continue;
+        }
+        for (size_t k = 0; k < 3; ++k) {
+            uint32_t a = c[k];
+            uint32_t b = c[(k + 1) % 3];
+            edges[detail::edge_key(a, b)].push_back(Use{uint32_t(t), a < b});
+        }
+    }
+
+    std::vector<uint8_t> flip(count, 0);
+    std::vector<uint8_t> visited(count, 0);
+    std::vector<uint32_t> piece;
+    for (size_t seed = 0; seed < count; ++seed) {
+        if (visited[seed] || degenerate[seed]) {
+            continue;
+        }
+        ++report.pieces;
+        bool closed = true;
+        piece.clear();
+        piece.push_back(uint32_t(seed));
+        visited[seed] = 1;
+        for (size_t next = 0; next < piece.size(); ++next) {
+            uint32_t t = piece[next];
+            for (size_t k = 0; k < 3; ++k) {
+                const auto& uses = edges[detail::edge_key(corner(t, k), corner(t, (k + 1) % 3))];
+                if (uses.size() != 2) {
+                    closed = false;  // a border, or more than two triangles meet
+                    continue;
+                }
+                const Use& self = uses[0].triangle == t ? uses[0] : uses[1];
+                const Use& other = uses[0].triangle == t ? uses[1] : uses[0];
+                if (visited[other.triangle]) {
+                    continue;
+                }
+                // neighbours agree when they walk the shared edge in opposite directions
+                flip[other.triangle] = flip[t] ^ (self.forward == other.forward);
+                visited[other.triangle] = 1;
+                piece.push_back(other.triangle);
+            }
+        }
+
+        bool invert;
+        if (closed) {
+            glm::vec3 origin = positions[indices[3 * seed]];
+            float volume = 0;
+            for (uint32_t t : piece) {
+                glm::vec3 a = positions[indices[3 * t]] - origin;
+                glm::vec3 b = positions[indices[3 * t + 1]] - origin;
+                glm::vec3 c = positions[indices[3 * t + 2]] - origin;
+                float signed_volume = glm::dot(a, glm::cross(b, c));
+                volume += flip[t] ? -signed_volume : signed_volume;
+            }
+            invert = volume < 0;
+        } else {
+            size_t changed = 0;
+            for (uint32_t t : piece) {
+                changed += flip[t];
+            }
+            invert = 2 * changed > piece.size();
+        }
+        if (invert) {
+            for (uint32_t t : piece) {
+                flip[t] ^= 1;
+            }
+        }
+        report.open_pieces += !closed;
+    }
+
+    for (size_t t = 0; t < count; ++t) {
+        if (flip[t]) {
+            std::swap(indices[3 * t + 1], indices[3 * t + 2]);
+            ++report.flipped;
+        }
+    }
+    if (flipped) {
+        flipped->swap(flip);
+    }
+    return report;
+}
+
+}  // namespace Winding
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "objects.hpp"
+#include "geometry_cache.hpp"
+#include "snapshot.hpp"
+#include "log.hpp"
+
+// The world as square cells streamed around the player.
+//
+// Cells within active_radius of the player's cell are active: they have a floor
+// tile and their targets are live objects owned by the game. Targets of other
+// cells are kept as compact snapshot records and are not simulated. With a
+// directory set, cells further than keep_radius are written out as snapshot
+// files and read back when the player comes close again, so memory and CPU
+// follow the active area rather than the size of the world.
+class WorldGrid {
+public:
+    struct CellId {
+        int x;
+        int z;
+
+        bool operator==(const CellId& other) const {
+            return x == other.x && z == other.z;
+        }
+    };
+
+    struct CellHash {
+        size_t operator()(const CellId& id) const {
+            return size_t(id.x) * 73856093u ^ size_t(id.z) * 19349663u;
+        }
+    };
+
+private:
+    struct Cell {
+        bool active = false;
+        bool on_disk = false;
+        Floor tile;
+        std::vector<Snapshot::EntityRecord> stored;  // targets while inactive
+    };
+
+    float _cell_size;
+    int _active_radius;
+    int _keep_radius;
+    std::string _directory;  // empty to keep every cell in memory
+    Floor _tile;             // floor of the cell around the origin
+    std::unordered_map<CellId, Cell, CellHash> _cells;
+    std::vector<CellId> _active;
+    CellId _center{0, 0};
+    bool _has_center = false;
+    size_t _stored_count = 0;
+
+    static int distance(const CellId& a, const CellId& b) {
+        return std::max(std::abs(a.x - b.x), std::abs(a.z - b.z));
+    }
+
+    std::string path(const CellId& id) const {
+        return _directory + "/cell_" + std::to_string(id.x) + "_" + std::to_string(id.z) + ".gchs";
+    }
+
+    void load(const CellId& id, Cell& cell) {
+        if (!cell.on_disk) {
+            return;
+        }
+        Snapshot::MappedFile file(path(id));
+        Snapshot::View view(file);
+        if (view.valid()) {
+            cell.stored.assign(view.entities().begin(), view.entities().end());
+            _stored_count += cell.stored.size();
+        } else {
+            LOG_ERROR("Failed to read world cell %d %d", id.x, id.z);
+        }
+        cell.on_disk = false;
+        std::remove(path(id).c_str());
+    }
+
+    void evict(const CellId& id, Cell& cell) {
+        Snapshot::Writer writer;
+        for (const auto& record : cell.stored) {
+            writer.add_entity(record);
+        }
+        if (!writer.write(path(id), 0)) {
+            return;  // stays in memory
+        }
+        _stored_count -= cell.stored.size();
+        cell.stored.clear();
+        cell.stored.shrink_to_fit();
+        cell.on_disk = true;
+    }
+
+    void activate(const CellId& id, GeometryCache& tiles) {
+        Cell& cell = _cells[id];
+        load(id, cell);
+        cell.active = true;
+        cell.tile = _tile;
+        cell.tile.move(glm::vec3(id.x * _cell_size, 0, id.z * _cell_size));
+        tiles.update(cell.tile);
+        _active.push_back(id);
+    }
+
+public:
+    WorldGrid(const Floor& tile, float cell_size, int active_radius, int keep_radius, const std::string& directory="")
+        : _cell_size(cell_size), _active_radius(active_radius), _keep_radius(keep_radius),
+          _directory(directory), _tile(tile) {}
+
+    CellId cell_of(const glm::vec3& position) const {
+        return CellId{int(std::floor(position.x / _cell_size + 0.5f)), int(std::floor(position.z / _cell_size + 0.5f))};
+    }
+
+    bool is_active(const glm::vec3& position) const {
+        return _has_center && distance(cell_of(position), _center) <= _active_radius;
+    }
+
+    const std::vector<CellId>& active_cells() const {
+        return _active;
+    }
+
+    const Floor& tile(const CellId& id) const {
+        return _cells.at(id).tile;
+    }
+
+    float cell_radius() const {
+        return _cell_size * 0.7072f;
+    }
+
+    size_t stored_count() const {
+        return _stored_count;
+    }
+
+    size_t cell_count() const {
+        return _cells.size();
+    }
+
+    // Keeps a target of an inactive cell until the cell is activated again.
+    void store(const Snapshot::EntityRecord& record) {
+        CellId id = cell_of(glm::vec3(record.center[0], record.center[1], record.center[2]));
+        Cell& cell = _cells[id];
+        load(id, cell);
+        cell.stored.push_back(record);
+        ++_stored_count;
+    }
+
+    // Moves the active area to the player's cell. Floor tiles of cells that
+    // change state are written to or freed from tiles. Returns the targets
+    // stored in the newly activated cells, for the caller to bring to life.
+    std::vector<Snapshot::EntityRecord> recenter(const glm::vec3& player, GeometryCache& tiles) {
+        std::vector<Snapshot::EntityRecord> restored;
+        CellId center = cell_of(player);
+        if (_has_center && center == _center) {
+            return restored;
+        }
+        _center = center;
+        _has_center = true;
+
+        for (size_t i = 0; i < _active.size();) {
+            if (distance(_active[i], center) > _active_radius) {
+                Cell& cell = _cells[_active[i]];
+                tiles.free(cell.tile);
+                cell.active = false;
+                _active[i] = _active.back();
+                _active.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        for (int x = center.x - _active_radius; x <= center.x + _active_radius; ++x) {
+            for (int z = center.z - _active_radius; z <= center.z + _active_radius; ++z) {
+                CellId id{x, z};
+                auto it = _cells.find(id);
+                if (it != _cells.end() && it->second.active) {
+                    continue;
+                }
+                activate(id, tiles);
+                Cell& cell = _cells[id];
+                restored.insert(restored.end(), cell.stored.begin(), cell.stored.end());
+                _stored_count -= cell.stored.size();
+                cell.stored.clear();
+            }
+        }
+
+        // far cells leave memory: empty ones are dropped, others written out
+        for (auto it = _cells.begin(); it != _cells.end();) {
+            Cell& cell = it->second;
+            if (!cell.active && distance(it->first, center) > _keep_radius) {
+                if (cell.stored.empty() && !cell.on_disk) {
+                    it = _cells.erase(it);
+                    continue;
+                }
+                if (!_directory.empty() && !cell.on_disk) {
+                    evict(it->first, cell);
+                }
+            }
+            ++it;
+        }
+        return restored;
+    }
+
+    // every stored target, including cells written to disk
+    std::vector<Snapshot::EntityRecord> stored_records() const {
+        std::vector<Snapshot::EntityRecord> records;
+        for (const auto& entry : _cells) {
+            const Cell& cell = entry.second;
+            records.insert(records.end(), cell.stored.begin(), cell.stored.end());
+            if (cell.on_disk) {
+                Snapshot::MappedFile file(path(entry.first));
+                Snapshot::View view(file);
+                if (view.valid()) {
+                    records.insert(records.end(), view.entities().begin(), view.entities().end());
+                }
+            }
+        }
+        return records;
+    }
+};
@@ -16,6 +16,8 @@ using namespace glm;
 
 #include <common/shader.hpp>
 
+#include "../common/primitives.hpp"
+
 int main( void )
 {
 	// Initialise GLFW
@@ -59,6 +61,8 @@ int main( void )
 	glEnable(GL_DEPTH_TEST);
 	// Accept fragment if it closer to the camera than the former one
 	glDepthFunc(GL_LESS); 
+	// The octahedron is closed and wound counter-clockwise seen from outside
+	glEnable(GL_CULL_FACE);
 
 	// Create and compile our GLSL program from the shaders
 	GLuint programID = LoadShaders( "TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader" );
@@ -72,38 +76,15 @@ int main( void )
 
 	// Projection matrix : 45� Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	glm::mat4 Projection = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
-	// Model matrix : an identity matrix (model will be at the origin)
-	glm::mat4 Model      = glm::mat4(1.0f);
+	// Model matrix : the unit octahedron turned by 45 degrees around z and scaled,
+	// so the corners of its middle square are at (+-1, +-1, 0)
+	glm::mat4 Model      = glm::scale(
+		glm::rotate(glm::mat4(1.0f), 3.14159265f / 4, glm::vec3(0, 0, 1)),
+		glm::vec3(sqrt(2.0f)));
 
 	// Our vertices. Tree consecutive floats give a 3D vertex; Three consecutive vertices give a triangle.
-	// A cube has 6 faces with 2 triangles each, so this makes 6*2=12 triangles, and 12*3 vertices
-	float h = sqrt(2);
-	static const GLfloat g_vertex_buffer_data[] = { 
-		-1.0f,-1.0f, 0.0f,  // 1
-		-1.0f, 1.0f, 0.0f,
-		 0.0f, 0.0f, h,
-		-1.0f, 1.0f, 0.0f,  // 2
-		 1.0f, 1.0f, 0.0f,
-		 0.0f, 0.0f, h,
-		 1.0f, 1.0f, 0.0f,  // 3
-		 1.0f,-1.0f, 0.0f,
-		 0.0f, 0.0f, h,
-		 1.0f,-1.0f, 0.0f,  // 4
-		-1.0f,-1.0f, 0.0f,
-		 0.0f, 0.0f, h,
-		-1.0f,-1.0f, 0.0f,  // 5
-		-1.0f, 1.0f, 0.0f,
-		 0.0f, 0.0f, -h,
-		 -1.0f, 1.0f, 0.0f,  // 6
-		 1.0f, 1.0f, 0.0f,
-		 0.0f, 0.0f, -h,
-		 1.0f, 1.0f, 0.0f,  // 7
-		 1.0f,-1.0f, 0.0f,
-		 0.0f, 0.0f, -h,
-		 1.0f,-1.0f, 0.0f,  // 8
-		 -1.0f,-1.0f, 0.0f,
-		 0.0f, 0.0f, -h,
-	};
+	// An octahedron has 8 faces, so this makes 8 triangles, and 8*3 vertices, generated at compile time
+	static constexpr auto g_vertex_buffer_data = Primitives::OCTAHEDRON.triangle_positions();
 
 	// One color for each vertex. They were generated randomly.
 	static const GLfloat g_color_buffer_data[] = { 
@@ -143,7 +124,7 @@ int main( void )
 	GLuint vertexbuffer;
 	glGenBuffers(1, &vertexbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data.data(), GL_STATIC_DRAW);
 
 	GLuint colorbuffer;
 	glGenBuffers(1, &colorbuffer);
@@ -202,7 +183,7 @@ int main( void )
 		);
 
 		// Draw the triangleS !
-		glDrawArrays(GL_TRIANGLES, 0, 12*3); // 12*3 indices starting at 0 -> 12 triangles
+		glDrawArrays(GL_TRIANGLES, 0, Primitives::OCTAHEDRON.index_count); // 8*3 indices starting at 0 -> 8 triangles
 
 		glDisableVertexAttribArray(vertexPosition_modelspaceID);
 		glDisableVertexAttribArray(vertexColorID);